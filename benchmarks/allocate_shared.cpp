@@ -0,0 +1,67 @@
+// Request handling that builds and drops a graph of small shared objects:
+// global allocator vs. a per-request `std::pmr::monotonic_buffer_resource`.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/allocate_shared.cpp -lbenchmark -lpthread
+
+#include "shared/shared.h"
+#include "shared/weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace {
+
+struct Item {
+    int64_t id;
+    SharedPtr<Item> parent;
+    double payload[4] = {};
+};
+
+template <typename Make>
+int64_t HandleRequest(int64_t items, Make&& make) {
+    std::vector<SharedPtr<Item>> index;
+    index.reserve(items);
+    SharedPtr<Item> parent;
+    for (int64_t i = 0; i < items; ++i) {
+        auto item = make(i, i % 8 == 0 ? SharedPtr<Item>() : parent);
+        if (i % 8 == 0) {
+            parent = item;
+        }
+        index.push_back(std::move(item));
+    }
+    int64_t sum = 0;
+    for (auto& item : index) {
+        sum += item->id + (item->parent ? item->parent->id : 0);
+    }
+    return sum;
+}
+
+void BM_RequestMakeShared(benchmark::State& state) {
+    for (auto _ : state) {
+        auto sum = HandleRequest(state.range(0), [](int64_t id, SharedPtr<Item> parent) {
+            return MakeShared<Item>(id, std::move(parent));
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RequestMakeShared)->Arg(64)->Arg(4096);
+
+void BM_RequestArena(benchmark::State& state) {
+    std::vector<std::byte> buffer(state.range(0) * 128);
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+        auto sum = HandleRequest(state.range(0), [&](int64_t id, SharedPtr<Item> parent) {
+            return AllocateShared<Item>(&arena, id, std::move(parent));
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RequestArena)->Arg(64)->Arg(4096);
+
+}  // namespace
+
+BENCHMARK_MAIN();
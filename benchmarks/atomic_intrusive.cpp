@@ -0,0 +1,84 @@
+// Reader-heavy access to a published intrusive snapshot (99% loads, 1% stores) from a growing number of threads:
+// `AtomicIntrusivePtr` vs. a mutex vs. `std::atomic<std::shared_ptr>`.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/atomic_intrusive.cpp -lbenchmark -lpthread
+
+#include "intrusive/atomic_intrusive.h"
+#include "intrusive/intrusive.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct Table : SimpleAtomicRefCounted<Table> {
+    explicit Table(int64_t version) : version(version) {
+    }
+
+    int64_t version;
+    int64_t routes[8] = {};
+};
+
+constexpr int64_t kStoreEvery = 100;
+
+AtomicIntrusivePtr<Table> atomic_slot(MakeIntrusive<Table>(0));
+
+IntrusivePtr<Table> locked_slot = MakeIntrusive<Table>(0);
+std::mutex locked_slot_mutex;
+
+std::atomic<std::shared_ptr<Table>> std_slot(std::make_shared<Table>(0));
+
+void BM_AtomicIntrusivePtr(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        if (++i % kStoreEvery == 0) {
+            atomic_slot.Store(MakeIntrusive<Table>(i));
+        } else {
+            auto table = atomic_slot.Load();
+            benchmark::DoNotOptimize(table->version);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AtomicIntrusivePtr)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_MutexGuarded(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        if (++i % kStoreEvery == 0) {
+            auto table = MakeIntrusive<Table>(i);
+            std::lock_guard guard(locked_slot_mutex);
+            locked_slot = std::move(table);
+        } else {
+            IntrusivePtr<Table> table;
+            {
+                std::lock_guard guard(locked_slot_mutex);
+                table = locked_slot;
+            }
+            benchmark::DoNotOptimize(table->version);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MutexGuarded)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_StdAtomicSharedPtr(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        if (++i % kStoreEvery == 0) {
+            std_slot.store(std::make_shared<Table>(i));
+        } else {
+            auto table = std_slot.load();
+            benchmark::DoNotOptimize(table->version);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StdAtomicSharedPtr)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
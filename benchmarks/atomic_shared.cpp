@@ -0,0 +1,61 @@
+// Reader-heavy access to a published `SharedPtr` (99% loads, 1% stores): `AtomicSharedPtr` vs. a mutex.
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/atomic_shared.cpp -lbenchmark -lpthread
+
+#include "shared/atomic_shared.h"
+#include "shared/shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+namespace {
+
+struct Table {
+    int64_t version;
+    int64_t routes[8] = {};
+};
+
+constexpr int64_t kStoreEvery = 100;
+
+AtomicSharedPtr<const Table> atomic_slot(MakeShared<const Table>(0));
+
+SharedPtr<const Table> locked_slot = MakeShared<const Table>(0);
+std::mutex locked_slot_mutex;
+
+void BM_AtomicSharedPtr(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        if (++i % kStoreEvery == 0) {
+            atomic_slot.Store(MakeShared<const Table>(i));
+        } else {
+            auto table = atomic_slot.Load();
+            benchmark::DoNotOptimize(table->version);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AtomicSharedPtr)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_MutexGuarded(benchmark::State& state) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        if (++i % kStoreEvery == 0) {
+            auto table = MakeShared<const Table>(i);
+            std::lock_guard guard(locked_slot_mutex);
+            locked_slot = std::move(table);
+        } else {
+            SharedPtr<const Table> table;
+            {
+                std::lock_guard guard(locked_slot_mutex);
+                table = locked_slot;
+            }
+            benchmark::DoNotOptimize(table->version);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MutexGuarded)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
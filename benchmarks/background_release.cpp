@@ -0,0 +1,129 @@
+// Pause of the thread that drops the last reference to a tree: destruction in place vs. handing it
+// to the background reclaimer, for growing trees. The pause is reported as median and 99th percentile;
+// `BM_DropStream` drops small trees back to back and shows how deep the reclaimer queue gets.
+// Needs thread-safe counters, the tree is destroyed on another thread.
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/background_release.cpp -lbenchmark -lpthread
+
+#include "intrusive/intrusive.h"
+#include "reclaim/background.h"
+#include "shared/shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+template <typename Policy>
+struct SharedNode : ReleasedWith<Policy> {
+    SharedPtr<SharedNode> left;
+    SharedPtr<SharedNode> right;
+};
+
+template <typename Deleter>
+struct IntrusiveNode : RefCounted<IntrusiveNode<Deleter>, AtomicCounter, Deleter> {
+    IntrusivePtr<IntrusiveNode> left;
+    IntrusivePtr<IntrusiveNode> right;
+};
+
+template <typename Node>
+SharedPtr<Node> BuildShared(size_t size) {
+    if (size == 0) {
+        return {};
+    }
+    auto node = MakeShared<Node>();
+    node->left = BuildShared<Node>((size - 1) / 2);
+    node->right = BuildShared<Node>(size - 1 - (size - 1) / 2);
+    return node;
+}
+
+template <typename Node>
+IntrusivePtr<Node> BuildIntrusive(size_t size) {
+    if (size == 0) {
+        return {};
+    }
+    auto node = MakeIntrusive<Node>();
+    node->left = BuildIntrusive<Node>((size - 1) / 2);
+    node->right = BuildIntrusive<Node>(size - 1 - (size - 1) / 2);
+    return node;
+}
+
+void ReportPauses(benchmark::State& state, std::vector<double>& pauses_us) {
+    std::sort(pauses_us.begin(), pauses_us.end());
+    state.counters["p50_pause_us"] = pauses_us[pauses_us.size() / 2];
+    state.counters["p99_pause_us"] = pauses_us[pauses_us.size() * 99 / 100];
+}
+
+// Manual timing: only the drop itself, the background reclaimer finishes outside of it.
+// The iteration count is fixed, the time of a single drop is far below the cost of an iteration.
+template <typename Node, typename Build>
+void DropTree(benchmark::State& state, Build build) {
+    std::vector<double> pauses_us;
+    for (auto _ : state) {
+        auto root = build(state.range(0));
+        auto start = std::chrono::steady_clock::now();
+        root.Reset();
+        auto pause = std::chrono::steady_clock::now() - start;
+        state.SetIterationTime(std::chrono::duration<double>(pause).count());
+        pauses_us.push_back(std::chrono::duration<double, std::micro>(pause).count());
+        BackgroundReclaimer::Default().Flush();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    ReportPauses(state, pauses_us);
+}
+
+template <typename Node>
+void BM_DropSharedTree(benchmark::State& state) {
+    DropTree<Node>(state, BuildShared<Node>);
+}
+BENCHMARK(BM_DropSharedTree<SharedNode<ImmediateRelease>>)->Range(1 << 6, 1 << 16)->UseManualTime()->Iterations(200);
+BENCHMARK(BM_DropSharedTree<SharedNode<BackgroundRelease>>)->Range(1 << 6, 1 << 16)->UseManualTime()->Iterations(200);
+
+template <typename Node>
+void BM_DropIntrusiveTree(benchmark::State& state) {
+    DropTree<Node>(state, BuildIntrusive<Node>);
+}
+BENCHMARK(BM_DropIntrusiveTree<IntrusiveNode<DefaultDelete>>)->Range(1 << 6, 1 << 16)->UseManualTime()->Iterations(200);
+BENCHMARK(BM_DropIntrusiveTree<IntrusiveNode<BackgroundDelete<>>>)->Range(1 << 6, 1 << 16)->UseManualTime()->Iterations(200);
+
+// Trees of 64 nodes prepared in advance and dropped one after another, the reclaimer keeps up or not
+template <typename Node>
+void BM_DropStream(benchmark::State& state) {
+    constexpr size_t kTreeSize = 64;
+    std::vector<SharedPtr<Node>> trees(state.range(0));
+    auto before = BackgroundReclaimer::Default().GetStats();
+    std::vector<double> pauses_us;
+    size_t max_depth = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& tree : trees) {
+            tree = BuildShared<Node>(kTreeSize);
+        }
+        state.ResumeTiming();
+        for (auto& tree : trees) {
+            auto start = std::chrono::steady_clock::now();
+            tree.Reset();
+            pauses_us.push_back(
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            max_depth = std::max(max_depth, BackgroundReclaimer::Default().GetStats().depth);
+        }
+        state.PauseTiming();
+        BackgroundReclaimer::Default().Flush();
+        state.ResumeTiming();
+    }
+    auto after = BackgroundReclaimer::Default().GetStats();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    ReportPauses(state, pauses_us);
+    state.counters["max_depth"] = static_cast<double>(max_depth);
+    state.counters["overflows"] =
+        benchmark::Counter(static_cast<double>(after.overflows - before.overflows), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_DropStream<SharedNode<ImmediateRelease>>)->Arg(1 << 12)->Iterations(20);
+BENCHMARK(BM_DropStream<SharedNode<BackgroundRelease>>)->Arg(1 << 12)->Iterations(20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,68 @@
+// Control block churn: threads keep a window of live objects, replace them one by one and hand every 16th
+// to another thread to be freed there. `SlabAllocator` vs. the global heap (glibc malloc).
+// Reports allocations per second and the resident set size after the run; RSS is per process, so compare it
+// running one allocator at a time with `--benchmark_filter`.
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/control_block_churn.cpp -lbenchmark -lpthread
+
+#include "alloc/slab.h"
+#include "shared/shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Item {
+    int64_t id;
+    double payload[2] = {};
+};
+
+constexpr size_t kHandOffEvery = 16;
+
+std::mutex mailbox_mutex;
+std::vector<SharedPtr<Item>> mailbox;
+
+double ResidentMegabytes() {
+    size_t total = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> total >> resident;
+    return static_cast<double>(resident * sysconf(_SC_PAGESIZE)) / (1 << 20);
+}
+
+template <typename Alloc>
+void BM_Churn(benchmark::State& state) {
+    const size_t window = state.range(0);
+    std::vector<SharedPtr<Item>> live(window);
+    std::vector<SharedPtr<Item>> received;
+    size_t next = 0;
+    for (auto _ : state) {
+        auto& slot = live[next % window];
+        if (next % kHandOffEvery == 0 && slot) {
+            std::lock_guard guard(mailbox_mutex);
+            mailbox.push_back(std::move(slot));
+            received.swap(mailbox);
+        }
+        slot = AllocateShared<Item>(Alloc(), static_cast<int64_t>(next));
+        received.clear();  // Possibly allocated by other threads
+        ++next;
+    }
+    live.clear();
+    {
+        std::lock_guard guard(mailbox_mutex);
+        mailbox.clear();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["rss_mb"] = ResidentMegabytes();
+}
+BENCHMARK(BM_Churn<std::allocator<Item>>)->Arg(1 << 16)->Threads(1)->Threads(4)->UseRealTime();
+BENCHMARK(BM_Churn<SlabAllocator<Item>>)->Arg(1 << 16)->Threads(1)->Threads(4)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
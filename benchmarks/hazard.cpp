@@ -0,0 +1,88 @@
+// Read throughput of a published object under contention: hazard pointers vs. reference counting.
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/hazard.cpp -lbenchmark -lpthread
+
+#include "intrusive/intrusive.h"
+#include "reclaim/hazard.h"
+#include "shared/shared.h"
+#include "shared/weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+
+namespace {
+
+struct Config : ReleasedWith<HazardRelease> {
+    int64_t value = 42;
+};
+
+struct Snapshot : RefCounted<Snapshot, SimpleCounter, HazardDelete<>> {
+    int64_t value = 42;
+};
+
+SharedPtr<Config> config = MakeShared<Config>();
+std::atomic<Config*> published_config = config.Get();
+WeakPtr<Config> weak_config = config;
+
+IntrusivePtr<Snapshot> snapshot = MakeIntrusive<Snapshot>();
+std::atomic<Snapshot*> published_snapshot = snapshot.Get();
+
+void BM_SharedPtrCopy(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<Config> copy = config;
+        benchmark::DoNotOptimize(copy->value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedPtrCopy)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_WeakPtrLock(benchmark::State& state) {
+    for (auto _ : state) {
+        auto locked = weak_config.Lock();
+        benchmark::DoNotOptimize(locked->value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WeakPtrLock)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_HazardSharedRead(benchmark::State& state) {
+    HazardPointer hazard;
+    for (auto _ : state) {
+        Config* current = hazard.Protect(published_config);
+        benchmark::DoNotOptimize(current->value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HazardSharedRead)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_HazardIntrusiveRead(benchmark::State& state) {
+    HazardPointer hazard;
+    for (auto _ : state) {
+        Snapshot* current = hazard.Protect(published_snapshot);
+        benchmark::DoNotOptimize(current->value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HazardIntrusiveRead)->ThreadRange(1, 16)->UseRealTime();
+
+// Single writer republishes the object, readers keep going.
+void BM_HazardReadWithWriter(benchmark::State& state) {
+    HazardPointer hazard;
+    int64_t i = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i % 100 == 0) {
+            auto next = MakeShared<Config>();
+            published_config.store(next.Get());
+            config = std::move(next);
+        } else {
+            Config* current = hazard.Protect(published_config);
+            benchmark::DoNotOptimize(current->value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HazardReadWithWriter)->ThreadRange(2, 16)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,111 @@
+// Copy/destroy of one `IntrusivePtr` from many threads: `SimpleCounter` (single thread or under a mutex)
+// vs. `AtomicCounter` vs. `std::shared_ptr`. `BM_*MakeDestroy` is the unique-owner case, where
+// `AtomicCounter` skips the read-modify-write on the last release. `BM_CopyDestroyImmortal` copies a static
+// object marked immortal: its counter is only read with `SMART_PTRS_IMMORTAL_OBJECTS`, compare both builds.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/intrusive_threads.cpp -lbenchmark -lpthread
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_IMMORTAL_OBJECTS benchmarks/intrusive_threads.cpp -lbenchmark -lpthread
+
+#include "intrusive/intrusive.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct SimpleObject : SimpleRefCounted<SimpleObject> {
+    int value = 42;
+};
+
+struct AtomicObject : SimpleAtomicRefCounted<AtomicObject> {
+    int value = 42;
+};
+
+IntrusivePtr<SimpleObject> simple_object = MakeIntrusive<SimpleObject>();
+std::mutex simple_object_mutex;
+IntrusivePtr<AtomicObject> atomic_object = MakeIntrusive<AtomicObject>();
+std::shared_ptr<int> std_object = std::make_shared<int>(42);
+
+AtomicObject immortal_object;
+IntrusivePtr<AtomicObject> immortal_pointer = [] {
+    immortal_object.MakeImmortal();
+    return IntrusivePtr<AtomicObject>(&immortal_object);
+}();
+
+void BM_CopyDestroySimple(benchmark::State& state) {
+    for (auto _ : state) {
+        IntrusivePtr<SimpleObject> copy = simple_object;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroySimple);
+
+void BM_CopyDestroySimpleMutexGuarded(benchmark::State& state) {
+    for (auto _ : state) {
+        std::lock_guard guard(simple_object_mutex);
+        IntrusivePtr<SimpleObject> copy = simple_object;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroySimpleMutexGuarded)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_CopyDestroyAtomic(benchmark::State& state) {
+    for (auto _ : state) {
+        IntrusivePtr<AtomicObject> copy = atomic_object;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyAtomic)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_CopyDestroyImmortal(benchmark::State& state) {
+    for (auto _ : state) {
+        IntrusivePtr<AtomicObject> copy = immortal_pointer;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyImmortal)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_CopyDestroyStd(benchmark::State& state) {
+    for (auto _ : state) {
+        std::shared_ptr<int> copy = std_object;
+        benchmark::DoNotOptimize(copy.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyStd)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_MakeDestroySimple(benchmark::State& state) {
+    for (auto _ : state) {
+        auto object = MakeIntrusive<SimpleObject>();
+        benchmark::DoNotOptimize(object.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeDestroySimple);
+
+void BM_MakeDestroyAtomic(benchmark::State& state) {
+    for (auto _ : state) {
+        auto object = MakeIntrusive<AtomicObject>();
+        benchmark::DoNotOptimize(object.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeDestroyAtomic);
+
+void BM_MakeDestroyStd(benchmark::State& state) {
+    for (auto _ : state) {
+        auto object = std::make_shared<int>(42);
+        benchmark::DoNotOptimize(object.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeDestroyStd);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+// Teardown of a big tree by dropping its root (single-threaded, recursive) vs. `ParallelRelease`
+// with a growing number of worker threads, for `IntrusivePtr` and `SharedPtr` nodes.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/parallel_release.cpp -lbenchmark -lpthread
+
+#include "intrusive/intrusive.h"
+#include "reclaim/parallel.h"
+#include "shared/shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <string>
+
+namespace {
+
+constexpr size_t kTreeSize = 1 << 20;
+
+struct IntrusiveNode : SimpleRefCounted<IntrusiveNode> {
+    IntrusivePtr<IntrusiveNode> left;
+    IntrusivePtr<IntrusiveNode> right;
+    std::string payload = std::string(32, 'x');  // Something for the destructor to free
+
+    template <typename Visitor>
+    void ForEachChild(Visitor&& visit) {
+        visit(left);
+        visit(right);
+    }
+};
+
+struct SharedNode {
+    SharedPtr<SharedNode> left;
+    SharedPtr<SharedNode> right;
+    std::string payload = std::string(32, 'x');
+
+    template <typename Visitor>
+    void ForEachChild(Visitor&& visit) {
+        visit(left);
+        visit(right);
+    }
+};
+
+template <typename Ptr, typename Make>
+Ptr BuildTree(size_t size, Make make) {
+    if (size == 0) {
+        return {};
+    }
+    Ptr node = make();
+    node->left = BuildTree<Ptr>((size - 1) / 2, make);
+    node->right = BuildTree<Ptr>(size - 1 - (size - 1) / 2, make);
+    return node;
+}
+
+IntrusivePtr<IntrusiveNode> BuildIntrusive() {
+    return BuildTree<IntrusivePtr<IntrusiveNode>>(kTreeSize, [] { return MakeIntrusive<IntrusiveNode>(); });
+}
+
+SharedPtr<SharedNode> BuildShared() {
+    return BuildTree<SharedPtr<SharedNode>>(kTreeSize, [] { return MakeShared<SharedNode>(); });
+}
+
+template <typename Build>
+void SerialTeardown(benchmark::State& state, Build build) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto root = build();
+        state.ResumeTiming();
+        root.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * kTreeSize);
+}
+
+// Argument: worker threads besides the calling one
+template <typename Build>
+void ParallelTeardown(benchmark::State& state, Build build) {
+    ReleaseWorkers workers(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto root = build();
+        state.ResumeTiming();
+        ParallelRelease(std::move(root), workers);
+    }
+    state.SetItemsProcessed(state.iterations() * kTreeSize);
+}
+
+void BM_IntrusiveSerial(benchmark::State& state) {
+    SerialTeardown(state, BuildIntrusive);
+}
+BENCHMARK(BM_IntrusiveSerial)->Unit(benchmark::kMillisecond);
+
+void BM_IntrusiveParallel(benchmark::State& state) {
+    ParallelTeardown(state, BuildIntrusive);
+}
+BENCHMARK(BM_IntrusiveParallel)->RangeMultiplier(2)->Range(1, 8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_SharedSerial(benchmark::State& state) {
+    SerialTeardown(state, BuildShared);
+}
+BENCHMARK(BM_SharedSerial)->Unit(benchmark::kMillisecond);
+
+void BM_SharedParallel(benchmark::State& state) {
+    ParallelTeardown(state, BuildShared);
+}
+BENCHMARK(BM_SharedParallel)->RangeMultiplier(2)->Range(1, 8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
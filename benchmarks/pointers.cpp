@@ -0,0 +1,314 @@
+// Every pointer type against its standard counterpart: `SharedPtr`/`WeakPtr`/`EnableSharedFromThis` vs.
+// `std::shared_ptr` & co, `UniquePtr` vs. `std::unique_ptr`, `IntrusivePtr` next to both.
+// Built for each counting mode by CMake (bench_pointers, bench_pointers_atomic, bench_pointers_biased);
+// contention variants need thread-safe counters and are compiled in atomic and biased modes only.
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/pointers.cpp -lbenchmark -lpthread
+
+#include "intrusive/intrusive.h"
+#include "shared/shared.h"
+#include "shared/weak.h"
+#include "unique/unique.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Same operations under the same names for both families
+struct Ours {
+    template <typename T>
+    using Shared = SharedPtr<T>;
+    template <typename T>
+    using Weak = WeakPtr<T>;
+    template <typename T>
+    using Unique = UniquePtr<T>;
+    template <typename T>
+    using EnableFromThis = EnableSharedFromThis<T>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return MakeShared<T>(std::forward<Args>(args)...);
+    }
+    template <typename T>
+    static Shared<T> Lock(const Weak<T>& weak) {
+        return weak.Lock();
+    }
+    template <typename T>
+    static Shared<T> FromThis(T& object) {
+        return object.SharedFromThis();
+    }
+    template <typename T>
+    static void Reset(Unique<T>& unique, T* ptr) {
+        unique.Reset(ptr);
+    }
+};
+
+struct Std {
+    template <typename T>
+    using Shared = std::shared_ptr<T>;
+    template <typename T>
+    using Weak = std::weak_ptr<T>;
+    template <typename T>
+    using Unique = std::unique_ptr<T>;
+    template <typename T>
+    using EnableFromThis = std::enable_shared_from_this<T>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+    template <typename T>
+    static Shared<T> Lock(const Weak<T>& weak) {
+        return weak.lock();
+    }
+    template <typename T>
+    static Shared<T> FromThis(T& object) {
+        return object.shared_from_this();
+    }
+    template <typename T>
+    static void Reset(Unique<T>& unique, T* ptr) {
+        unique.reset(ptr);
+    }
+};
+
+struct Payload {
+    int64_t value = 42;
+};
+
+template <typename Family>
+struct Widget : Family::template EnableFromThis<Widget<Family>> {
+    int64_t value = 42;
+};
+
+// Finds its block instead of storing a `WeakPtr`
+struct InPlaceWidget : EnableSharedFromThisInPlace<InPlaceWidget> {
+    int64_t value = 42;
+};
+
+struct IntrusivePayload : SimpleRefCounted<IntrusivePayload> {
+    int64_t value = 42;
+};
+
+constexpr int64_t kDestroyBatch = 1 << 10;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Single thread
+
+template <typename Family>
+void BM_Copy(benchmark::State& state) {
+    auto value = Family::template Make<Payload>();
+    for (auto _ : state) {
+        typename Family::template Shared<Payload> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Copy<Ours>);
+BENCHMARK(BM_Copy<Std>);
+
+template <typename Family>
+void BM_Move(benchmark::State& state) {
+    auto first = Family::template Make<Payload>();
+    typename Family::template Shared<Payload> second;
+    for (auto _ : state) {
+        second = std::move(first);
+        first = std::move(second);
+        benchmark::DoNotOptimize(first);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_Move<Ours>);
+BENCHMARK(BM_Move<Std>);
+
+// Dropping non-last references
+template <typename Family>
+void BM_Destroy(benchmark::State& state) {
+    auto value = Family::template Make<Payload>();
+    std::vector<typename Family::template Shared<Payload>> copies;
+    for (auto _ : state) {
+        state.PauseTiming();
+        copies.assign(kDestroyBatch, value);
+        state.ResumeTiming();
+        copies.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kDestroyBatch);
+}
+BENCHMARK(BM_Destroy<Ours>);
+BENCHMARK(BM_Destroy<Std>);
+
+template <typename Family>
+void BM_MakeShared(benchmark::State& state) {
+    for (auto _ : state) {
+        auto value = Family::template Make<Payload>();
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeShared<Ours>);
+BENCHMARK(BM_MakeShared<Std>);
+
+void BM_MakeIntrusive(benchmark::State& state) {
+    for (auto _ : state) {
+        auto value = MakeIntrusive<IntrusivePayload>();
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeIntrusive);
+
+void BM_IntrusiveCopy(benchmark::State& state) {
+    auto value = MakeIntrusive<IntrusivePayload>();
+    for (auto _ : state) {
+        IntrusivePtr<IntrusivePayload> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IntrusiveCopy);
+
+template <typename Family>
+void BM_WeakLock(benchmark::State& state) {
+    auto value = Family::template Make<Payload>();
+    typename Family::template Weak<Payload> weak = value;
+    for (auto _ : state) {
+        auto locked = Family::Lock(weak);
+        benchmark::DoNotOptimize(locked);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WeakLock<Ours>);
+BENCHMARK(BM_WeakLock<Std>);
+
+template <typename Family>
+void BM_WeakLockExpired(benchmark::State& state) {
+    typename Family::template Weak<Payload> weak = Family::template Make<Payload>();
+    for (auto _ : state) {
+        auto locked = Family::Lock(weak);
+        benchmark::DoNotOptimize(locked);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WeakLockExpired<Ours>);
+BENCHMARK(BM_WeakLockExpired<Std>);
+
+template <typename Family>
+void BM_MakeSharedFromThis(benchmark::State& state) {
+    for (auto _ : state) {
+        auto value = Family::template Make<Widget<Family>>();
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());    state.counters["object_bytes"] = sizeof(Widget<Family>);
+}
+BENCHMARK(BM_MakeSharedFromThis<Ours>);
+BENCHMARK(BM_MakeSharedFromThis<Std>);
+
+template <typename Family>
+void BM_SharedFromThis(benchmark::State& state) {
+    auto value = Family::template Make<Widget<Family>>();
+    for (auto _ : state) {
+        auto self = Family::FromThis(*value);
+        benchmark::DoNotOptimize(self);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedFromThis<Ours>);
+BENCHMARK(BM_SharedFromThis<Std>);
+
+void BM_MakeSharedFromThisInPlace(benchmark::State& state) {
+    for (auto _ : state) {
+        auto value = MakeShared<InPlaceWidget>();
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["object_bytes"] = sizeof(InPlaceWidget);
+}
+BENCHMARK(BM_MakeSharedFromThisInPlace);
+
+void BM_SharedFromThisInPlace(benchmark::State& state) {
+    auto value = MakeShared<InPlaceWidget>();
+    for (auto _ : state) {
+        auto self = value->SharedFromThis();
+        benchmark::DoNotOptimize(self);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedFromThisInPlace);
+
+template <typename Family>
+void BM_UniqueReset(benchmark::State& state) {
+    typename Family::template Unique<Payload> unique;
+    for (auto _ : state) {
+        Family::Reset(unique, new Payload);
+        benchmark::DoNotOptimize(unique);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UniqueReset<Ours>);
+BENCHMARK(BM_UniqueReset<Std>);
+
+template <typename Family>
+void BM_UniqueMoveReset(benchmark::State& state) {
+    typename Family::template Unique<Payload> unique;
+    for (auto _ : state) {
+        Family::Reset(unique, new Payload);
+        auto moved = std::move(unique);
+        benchmark::DoNotOptimize(moved);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UniqueMoveReset<Ours>);
+BENCHMARK(BM_UniqueMoveReset<Std>);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// N threads on one object
+
+#if defined(SMART_PTRS_ATOMIC_REFCOUNT) || defined(SMART_PTRS_BIASED_REFCOUNT)
+template <typename Family>
+typename Family::template Shared<Payload>& Contended() {
+    static auto value = Family::template Make<Payload>();
+    return value;
+}
+
+template <typename Family>
+void BM_ContendedCopy(benchmark::State& state) {
+    auto& value = Contended<Family>();
+    for (auto _ : state) {
+        typename Family::template Shared<Payload> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ContendedCopy<Ours>)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ContendedCopy<Std>)->ThreadRange(1, 16)->UseRealTime();
+
+template <typename Family>
+void BM_ContendedWeakLock(benchmark::State& state) {
+    typename Family::template Weak<Payload> weak = Contended<Family>();
+    for (auto _ : state) {
+        auto locked = Family::Lock(weak);
+        benchmark::DoNotOptimize(locked);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ContendedWeakLock<Ours>)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ContendedWeakLock<Std>)->ThreadRange(1, 16)->UseRealTime();
+
+// Every thread owns its pointer: no sharing, the cost of thread-safe counters alone
+template <typename Family>
+void BM_ThreadLocalCopy(benchmark::State& state) {
+    auto value = Family::template Make<Payload>();
+    for (auto _ : state) {
+        typename Family::template Shared<Payload> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadLocalCopy<Ours>)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ThreadLocalCopy<Std>)->ThreadRange(1, 16)->UseRealTime();
+#endif
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,275 @@
+// Counter operations done by `SharedPtr`/`WeakPtr` copies, moves, assignments, `Reset` and release of the last owner.
+// Control blocks count with `CountingCounter`, which wraps the counter of the mode. Every benchmark reports
+// `ops` per iteration and fails (so does the whole binary) if that is not the minimum: an increment
+// for a new owner, a decrement for the old one, nothing if the block stays the same.
+// `BM_MakeSharedDestroy` also fails if an object reaches itself through `SharedFromThis()` in its destructor.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/refcount_ops.cpp -lbenchmark -lpthread
+
+#include <cstdint>
+
+// Picked up by shared/ref_counters.h through `SMART_PTRS_SHARED_COUNTER`, so it comes before the headers.
+// A decrement that takes the `ReleaseIfUnique()` shortcut is counted there.
+template <typename Counter>
+class CountingCounter : public Counter {
+public:
+    void IncRef() {
+        ++ops;
+        Counter::IncRef();
+    }
+    bool TryIncRef() {
+        ++ops;
+        return Counter::TryIncRef();
+    }
+    auto DecRef() {
+        ++ops;
+        return Counter::DecRef();
+    }
+    void IncWeakRef() {
+        ++ops;
+        Counter::IncWeakRef();
+    }
+    auto DecWeakRef() {
+        ++ops;
+        return Counter::DecWeakRef();
+    }
+    bool ReleaseIfUnique() {
+        bool unique = Counter::ReleaseIfUnique();
+        ops += unique;
+        return unique;
+    }
+
+    static inline int64_t ops = 0;
+};
+
+#ifdef SMART_PTRS_ATOMIC_REFCOUNT
+#define SMART_PTRS_SHARED_COUNTER CountingCounter<AtomicSharedCounter>
+#else
+#define SMART_PTRS_SHARED_COUNTER CountingCounter<SimpleSharedCounter>
+#endif
+
+#include "shared/shared.h"
+#include "shared/weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <utility>  // std::move
+
+namespace {
+
+using Ops = SharedRefCounter;
+
+bool failed = false;
+
+struct Base {
+    virtual ~Base() = default;
+};
+struct Derived : Base {};
+
+// Sees no strong references to itself while it is destroyed, whichever way the last one is dropped
+struct SelfAware : EnableSharedFromThisInPlace<SelfAware> {
+    ~SelfAware() {
+        try {
+            SharedFromThis();
+            saw_owner = true;
+        } catch (const BadWeakPtr&) {
+        }
+        saw_owner |= !WeakFromThis().Expired();
+    }
+
+    static inline bool saw_owner = false;
+};
+
+// Objects stay alive through the whole benchmark, so no operation releases the last reference.
+void CheckOps(benchmark::State& state, int64_t expected_per_iteration) {
+    state.counters["ops"] = benchmark::Counter(static_cast<double>(Ops::ops), benchmark::Counter::kAvgIterations);
+    if (Ops::ops != expected_per_iteration * state.iterations()) {
+        failed = true;
+        state.SkipWithError("unexpected number of counter operations");
+    }
+}
+
+void BM_CopyDestroy(benchmark::State& state) {
+    auto value = MakeShared<int>(42);
+    Ops::ops = 0;
+    for (auto _ : state) {
+        SharedPtr<int> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    CheckOps(state, 2);
+}
+BENCHMARK(BM_CopyDestroy);
+
+void BM_MoveConstruct(benchmark::State& state) {
+    auto value = MakeShared<int>(42);
+    Ops::ops = 0;
+    for (auto _ : state) {
+        SharedPtr<int> moved = std::move(value);
+        value = std::move(moved);
+        benchmark::DoNotOptimize(value);
+    }
+    CheckOps(state, 0);
+}
+BENCHMARK(BM_MoveConstruct);
+
+// `Assign`: one increment and one decrement when the block changes
+void BM_CopyAssign(benchmark::State& state) {
+    auto first = MakeShared<int>(1);
+    auto second = MakeShared<int>(2);
+    SharedPtr<int> target = second;
+    Ops::ops = 0;
+    for (auto _ : state) {
+        target = first;
+        target = second;
+        benchmark::DoNotOptimize(target);
+    }
+    CheckOps(state, 4);
+}
+BENCHMARK(BM_CopyAssign);
+
+void BM_CopyAssignSameBlock(benchmark::State& state) {
+    auto value = MakeShared<int>(1);
+    SharedPtr<int> alias(value, value.Get());
+    SharedPtr<int> target = value;
+    Ops::ops = 0;
+    for (auto _ : state) {
+        target = value;
+        target = alias;
+        benchmark::DoNotOptimize(target);
+    }
+    CheckOps(state, 0);
+}
+BENCHMARK(BM_CopyAssignSameBlock);
+
+void BM_ConvertingAssign(benchmark::State& state) {
+    SharedPtr<Derived> first = MakeShared<Derived>();
+    SharedPtr<Derived> second = MakeShared<Derived>();
+    SharedPtr<Base> target = second;
+    Ops::ops = 0;
+    for (auto _ : state) {
+        target = first;
+        target = second;
+        benchmark::DoNotOptimize(target);
+    }
+    CheckOps(state, 4);
+}
+BENCHMARK(BM_ConvertingAssign);
+
+// `Steal`: only the old reference of the target is dropped
+void BM_MoveAssign(benchmark::State& state) {
+    auto value = MakeShared<int>(1);
+    auto other = MakeShared<int>(2);
+    SharedPtr<int> target = other;
+    Ops::ops = 0;
+    for (auto _ : state) {
+        SharedPtr<int> first = value;
+        SharedPtr<int> second = other;
+        target = std::move(first);
+        target = std::move(second);
+        benchmark::DoNotOptimize(target);
+    }
+    CheckOps(state, 4);
+}
+BENCHMARK(BM_MoveAssign);
+
+void BM_ConvertingMoveAssign(benchmark::State& state) {
+    SharedPtr<Derived> value = MakeShared<Derived>();
+    SharedPtr<Base> target;
+    Ops::ops = 0;
+    for (auto _ : state) {
+        SharedPtr<Derived> moved = std::move(value);
+        target = std::move(moved);
+        value = SharedPtr<Derived>(target, static_cast<Derived*>(target.Get()));
+        target.Reset();
+        benchmark::DoNotOptimize(value);
+    }
+    CheckOps(state, 2);
+}
+BENCHMARK(BM_ConvertingMoveAssign);
+
+void BM_Reset(benchmark::State& state) {
+    auto value = MakeShared<int>(1);
+    Ops::ops = 0;
+    for (auto _ : state) {
+        SharedPtr<int> copy = value;
+        copy.Reset();
+        copy.Reset();
+        benchmark::DoNotOptimize(copy);
+    }
+    CheckOps(state, 2);
+}
+BENCHMARK(BM_Reset);
+
+void BM_WeakAssign(benchmark::State& state) {
+    auto first = MakeShared<int>(1);
+    auto second = MakeShared<int>(2);
+    WeakPtr<int> weak_first(first);
+    WeakPtr<int> target(second);
+    Ops::ops = 0;
+    for (auto _ : state) {
+        target = weak_first;
+        target = second;
+        target = second;
+        benchmark::DoNotOptimize(target);
+    }
+    CheckOps(state, 4);
+}
+BENCHMARK(BM_WeakAssign);
+
+void BM_WeakMoveAssignAndReset(benchmark::State& state) {
+    auto value = MakeShared<int>(1);
+    WeakPtr<int> target(value);
+    Ops::ops = 0;
+    for (auto _ : state) {
+        WeakPtr<int> weak(value);
+        target = std::move(weak);
+        target.Reset();
+        target = value;
+        benchmark::DoNotOptimize(target);
+    }
+    CheckOps(state, 4);
+}
+BENCHMARK(BM_WeakMoveAssignAndReset);
+
+// The last reference is dropped: plain mode decrements both counts, atomic mode takes the unique-owner shortcut
+void BM_MakeSharedDestroy(benchmark::State& state) {
+    Ops::ops = 0;
+    for (auto _ : state) {
+        auto object = MakeShared<SelfAware>();
+        benchmark::DoNotOptimize(object);
+    }
+    if (SelfAware::saw_owner) {
+        failed = true;
+        state.SkipWithError("SharedFromThis() succeeded in the destructor");
+        return;
+    }
+#ifdef SMART_PTRS_ATOMIC_REFCOUNT
+    CheckOps(state, 2);
+#else
+    CheckOps(state, 3);
+#endif
+}
+BENCHMARK(BM_MakeSharedDestroy);
+
+void BM_Lock(benchmark::State& state) {
+    auto value = MakeShared<int>(1);
+    WeakPtr<int> weak(value);
+    Ops::ops = 0;
+    for (auto _ : state) {
+        auto locked = weak.Lock();
+        benchmark::DoNotOptimize(locked);
+    }
+    CheckOps(state, 2);
+}
+BENCHMARK(BM_Lock);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return failed ? 1 : 0;
+}
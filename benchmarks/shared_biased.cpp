@@ -0,0 +1,120 @@
+// Thread-local and cross-thread use of `SharedPtr`, to compare counting modes.
+// Build with each of them:
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/shared_biased.cpp -lbenchmark -lpthread
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/shared_biased.cpp -lbenchmark -lpthread
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_BIASED_REFCOUNT benchmarks/shared_biased.cpp -lbenchmark -lpthread
+// Biased counters should be close to plain ones for the thread-local loops.
+
+#include "shared/shared.h"
+#include "shared/weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Payload {
+    static inline std::atomic<int64_t> alive = 0;
+
+    Payload() {
+        alive.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~Payload() {
+        alive.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    int64_t value = 42;
+};
+
+void BM_ThreadLocalCopyDestroy(benchmark::State& state) {
+    auto value = MakeShared<Payload>();
+    for (auto _ : state) {
+        SharedPtr<Payload> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadLocalCopyDestroy);
+
+void BM_ThreadLocalCopyVector(benchmark::State& state) {
+    std::vector<SharedPtr<Payload>> values;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        values.push_back(MakeShared<Payload>());
+    }
+    for (auto _ : state) {
+        auto copy = values;
+        benchmark::DoNotOptimize(copy.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ThreadLocalCopyVector)->Arg(1 << 10);
+
+#if defined(SMART_PTRS_ATOMIC_REFCOUNT) || defined(SMART_PTRS_BIASED_REFCOUNT)
+// Objects are created here and handed off to a consumer thread, which copies and drops them.
+void BM_HandOff(benchmark::State& state) {
+    const int64_t batch_size = state.range(0);
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<SharedPtr<Payload>> batch;
+    bool stop = false;
+
+    std::thread consumer([&] {
+        std::unique_lock lock(mutex);
+        while (true) {
+            cv.wait(lock, [&] { return stop || !batch.empty(); });
+            if (batch.empty()) {
+                return;
+            }
+            auto taken = std::move(batch);
+            batch.clear();
+            lock.unlock();
+            for (auto& value : taken) {
+                SharedPtr<Payload> copy = value;
+                benchmark::DoNotOptimize(copy->value);
+            }
+            taken.clear();
+            lock.lock();
+            cv.notify_all();
+        }
+    });
+
+    for (auto _ : state) {
+        std::vector<SharedPtr<Payload>> produced;
+        for (int64_t i = 0; i < batch_size; ++i) {
+            produced.push_back(MakeShared<Payload>());
+        }
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&] { return batch.empty(); });
+            batch = std::move(produced);
+        }
+        cv.notify_all();
+#ifdef SMART_PTRS_BIASED_REFCOUNT
+        MergeBiasedRefCounts();
+#endif
+    }
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    consumer.join();
+#ifdef SMART_PTRS_BIASED_REFCOUNT
+    MergeBiasedRefCounts();
+#endif
+    if (Payload::alive.load() != 0) {
+        state.SkipWithError("objects leaked");
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_HandOff)->Arg(1 << 10)->UseRealTime();
+#endif
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,75 @@
+// Copy-heavy loops over `SharedPtr`: the cost of a single refcount operation.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/shared_copy.cpp -lbenchmark -lpthread
+
+#include "shared/shared.h"
+#include "shared/weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+
+void BM_CopyDestroy(benchmark::State& state) {
+    auto value = MakeShared<int>(42);
+    for (auto _ : state) {
+        SharedPtr<int> copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroy);
+
+void BM_CopyAssign(benchmark::State& state) {
+    auto first = MakeShared<int>(1);
+    auto second = MakeShared<int>(2);
+    SharedPtr<int> target;
+    for (auto _ : state) {
+        target = first;
+        target = second;
+        benchmark::DoNotOptimize(target);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_CopyAssign);
+
+void BM_MoveAssign(benchmark::State& state) {
+    SharedPtr<int> first = MakeShared<int>(1);
+    SharedPtr<int> second;
+    for (auto _ : state) {
+        second = std::move(first);
+        first = std::move(second);
+        benchmark::DoNotOptimize(first);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_MoveAssign);
+
+// Typical "copy a container of pointers" loop.
+void BM_CopyVector(benchmark::State& state) {
+    std::vector<SharedPtr<int>> values;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        values.push_back(MakeShared<int>(i));
+    }
+    for (auto _ : state) {
+        auto copy = values;
+        benchmark::DoNotOptimize(copy.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CopyVector)->Arg(1 << 10)->Arg(1 << 16);
+
+void BM_WeakLock(benchmark::State& state) {
+    auto value = MakeShared<int>(42);
+    WeakPtr<int> weak = value;
+    for (auto _ : state) {
+        auto locked = weak.Lock();
+        benchmark::DoNotOptimize(locked);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WeakLock);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,80 @@
+// Copy/destroy of one `SharedPtr` from many threads.
+// Build twice to compare counting modes:
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/shared_threads.cpp -lbenchmark -lpthread
+//     g++ -std=c++20 -O2 -I smart-ptrs -DSMART_PTRS_ATOMIC_REFCOUNT benchmarks/shared_threads.cpp -lbenchmark -lpthread
+// Plain counters can only be shared under a mutex; atomic ones need no outer lock.
+// `BM_CopyDestroyImmortal` skips the counter only with `-DSMART_PTRS_IMMORTAL_OBJECTS` added.
+
+#include "shared/shared.h"
+#include "shared/weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+namespace {
+
+SharedPtr<int> shared_value = MakeShared<int>(42);
+std::mutex shared_value_mutex;
+
+void BM_CopyDestroyMutexGuarded(benchmark::State& state) {
+    for (auto _ : state) {
+        std::lock_guard guard(shared_value_mutex);
+        SharedPtr<int> copy = shared_value;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyMutexGuarded)->ThreadRange(1, 16)->UseRealTime();
+
+#ifdef SMART_PTRS_ATOMIC_REFCOUNT
+void BM_CopyDestroyAtomic(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<int> copy = shared_value;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyAtomic)->ThreadRange(1, 16)->UseRealTime();
+
+// Every thread owns its pointer: the case where the counters are not contended at all.
+void BM_CopyDestroyAtomicThreadLocal(benchmark::State& state) {
+    auto value = MakeShared<int>(42);
+    for (auto _ : state) {
+        SharedPtr<int> copy = value;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyAtomicThreadLocal)->ThreadRange(1, 16)->UseRealTime();
+
+// An immortal object: copies only read the counter, threads don't share its cache line in modified state.
+SharedPtr<int> immortal_value = [] {
+    auto value = MakeShared<int>(42);
+    value.MakeImmortal();
+    return value;
+}();
+
+void BM_CopyDestroyImmortal(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<int> copy = immortal_value;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyDestroyImmortal)->ThreadRange(1, 16)->UseRealTime();
+#endif
+
+// Last owner goes away: takes the shortcut in atomic mode.
+void BM_MakeSharedDestroy(benchmark::State& state) {
+    for (auto _ : state) {
+        auto value = MakeShared<int>(42);
+        benchmark::DoNotOptimize(value.Get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeSharedDestroy);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,144 @@
+// Teardown of a linked list by dropping the reference to its head: recursive destruction (the default)
+// vs. the iterative release queue, for all three pointer families. Recursion is measured on short lists only,
+// long ones overflow the stack. `BM_BudgetedTeardown` spreads a long teardown over many bounded releases
+// and reports the pauses: median, 99th percentile and the longest one.
+//     g++ -std=c++20 -O2 -I smart-ptrs benchmarks/teardown.cpp -lbenchmark -lpthread
+
+#include "intrusive/intrusive.h"
+#include "reclaim/iterative.h"
+#include "shared/shared.h"
+#include "unique/unique.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+template <typename Policy>
+struct SharedNode : ReleasedWith<Policy> {
+    SharedPtr<SharedNode> next;
+};
+
+template <typename Deleter>
+struct IntrusiveNode : RefCounted<IntrusiveNode<Deleter>, SimpleCounter, Deleter> {
+    IntrusivePtr<IntrusiveNode> next;
+};
+
+template <template <typename> class Deleter>
+struct UniqueNode {
+    UniquePtr<UniqueNode, Deleter<UniqueNode>> next;
+};
+
+template <typename T>
+using IterativeUniqueDeleter = IterativeDeleter<T>;
+
+template <typename Node>
+SharedPtr<Node> BuildShared(size_t length) {
+    SharedPtr<Node> head;
+    for (size_t i = 0; i < length; ++i) {
+        auto node = MakeShared<Node>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+template <typename Node>
+IntrusivePtr<Node> BuildIntrusive(size_t length) {
+    IntrusivePtr<Node> head;
+    for (size_t i = 0; i < length; ++i) {
+        auto node = MakeIntrusive<Node>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+template <typename Node>
+auto BuildUnique(size_t length) {
+    decltype(Node::next) head;
+    for (size_t i = 0; i < length; ++i) {
+        decltype(Node::next) node(new Node);
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    return head;
+}
+
+template <typename Node>
+void BM_SharedTeardown(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto head = BuildShared<Node>(state.range(0));
+        state.ResumeTiming();
+        head.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SharedTeardown<SharedNode<ImmediateRelease>>)->Range(1 << 10, 1 << 14);
+BENCHMARK(BM_SharedTeardown<SharedNode<IterativeRelease<>>>)->Range(1 << 10, 1 << 20);
+
+template <typename Node>
+void BM_IntrusiveTeardown(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto head = BuildIntrusive<Node>(state.range(0));
+        state.ResumeTiming();
+        head.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_IntrusiveTeardown<IntrusiveNode<DefaultDelete>>)->Range(1 << 10, 1 << 14);
+BENCHMARK(BM_IntrusiveTeardown<IntrusiveNode<IterativeDelete<>>>)->Range(1 << 10, 1 << 20);
+
+template <typename Node>
+void BM_UniqueTeardown(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto head = BuildUnique<Node>(state.range(0));
+        state.ResumeTiming();
+        head.Reset();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UniqueTeardown<UniqueNode<MyDefaultDelete>>)->Range(1 << 10, 1 << 14);
+BENCHMARK(BM_UniqueTeardown<UniqueNode<IterativeUniqueDeleter>>)->Range(1 << 10, 1 << 20);
+
+// A release destroys at most 4096 nodes, the rest is drained in steps of the same size
+void BM_BudgetedTeardown(benchmark::State& state) {
+    constexpr size_t kBudget = 4096;
+    using Node = SharedNode<IterativeRelease<kBudget>>;
+    std::vector<double> pauses_us;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto head = BuildShared<Node>(state.range(0));
+        state.ResumeTiming();
+        auto start = std::chrono::steady_clock::now();
+        head.Reset();
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            pauses_us.push_back(std::chrono::duration<double, std::micro>(now - start).count());
+            if (PendingReleases() == 0) {
+                break;
+            }
+            start = now;
+            DrainReleaseQueue(kBudget);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::sort(pauses_us.begin(), pauses_us.end());
+    state.counters["p50_pause_us"] = pauses_us[pauses_us.size() / 2];
+    state.counters["p99_pause_us"] = pauses_us[pauses_us.size() * 99 / 100];
+    state.counters["max_pause_us"] = pauses_us.back();
+    state.counters["steps"] =
+        benchmark::Counter(static_cast<double>(pauses_us.size()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_BudgetedTeardown)->Arg(1 << 20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
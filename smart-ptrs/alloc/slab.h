@@ -0,0 +1,380 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <new>
+#include <utility>  // std::exchange
+
+// Size-class slab allocator with thread caches, for small same-sized objects like control blocks
+// (see `SMART_PTRS_SLAB_CONTROL_BLOCKS` in shared/shared.h).
+//
+// Every slab is a `kSlabSize`-aligned chunk carved into objects of one size class and owned by one thread.
+// The owner allocates and frees without atomics. Other threads push freed objects to the remote list
+// of the slab, the owner collects them when it runs out of space. Slabs of exited threads are adopted
+// by threads that need new ones, empty slabs go back to the system.
+class SlabHeap {
+public:
+    static constexpr size_t kMaxSize = 256;
+    static constexpr size_t kAlignment = 16;
+
+    static bool Handles(size_t size, size_t alignment) {
+        return size != 0 && size <= kMaxSize && alignment <= kAlignment;
+    }
+
+    // `size` has to be `Handles`-d.
+    static void* Allocate(size_t size) {
+        size_t size_class = (size - 1) / kAlignment;
+        if (Cache* cache = CurrentCache()) {
+            return cache->Allocate(size_class);
+        }
+        // Thread is exiting and its cache is already gone
+        std::lock_guard guard(Fallback().mutex);
+        return Fallback().cache.Allocate(size_class);
+    }
+    static void Deallocate(void* object) {
+        Slab* slab = Slab::Of(object);
+        Cache* cache = CurrentCache();
+        if (cache && slab->owner.load(std::memory_order_relaxed) == cache) {
+            cache->Free(slab, object);
+        } else {
+            slab->PushRemote(object);
+        }
+    }
+
+private:
+    static constexpr size_t kSlabSize = 64 << 10;
+    static constexpr size_t kClasses = kMaxSize / kAlignment;
+
+    struct FreeNode {
+        FreeNode* next;
+    };
+    class Cache;
+
+    struct Slab {
+        std::atomic<Cache*> owner;
+        size_t size_class;
+        // Touched by the owner only
+        Slab* prev = nullptr;
+        Slab* next = nullptr;
+        FreeNode* free = nullptr;
+        char* bump = nullptr;  // Never allocated space starts here
+        size_t used = 0;
+        bool full = false;  // In the list of slabs without space
+        // Objects freed by other threads
+        alignas(64) std::atomic<FreeNode*> remote_free = nullptr;
+
+        static Slab* Create(Cache* owner, size_t size_class) {
+            void* memory = Depot().TakeSpare();
+            if (!memory) {
+                memory = ::operator new(kSlabSize, std::align_val_t(kSlabSize));
+            }
+            auto slab = new (memory) Slab{owner, size_class};
+            slab->bump = reinterpret_cast<char*>(slab) + kHeaderSize;
+            return slab;
+        }
+        static void Destroy(Slab* slab) {
+            slab->~Slab();
+            if (!Depot().PutSpare(slab)) {
+                ::operator delete(slab, std::align_val_t(kSlabSize));
+            }
+        }
+        static Slab* Of(void* object) {
+            return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(object) & ~(kSlabSize - 1));
+        }
+
+        size_t ObjectSize() const {
+            return (size_class + 1) * kAlignment;
+        }
+        bool HasSpace() const {
+            return free || bump + ObjectSize() <= reinterpret_cast<const char*>(this) + kSlabSize;
+        }
+        void* Pop() {
+            ++used;
+            if (free) {
+                return std::exchange(free, free->next);
+            }
+            return std::exchange(bump, bump + ObjectSize());
+        }
+        void Push(void* object) {
+            --used;
+            free = new (object) FreeNode{free};
+        }
+
+        void PushRemote(void* object) {
+            auto node = new (object) FreeNode{remote_free.load(std::memory_order_relaxed)};
+            while (!remote_free.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                                      std::memory_order_relaxed)) {
+            }
+        }
+        bool HasRemote() const {
+            return remote_free.load(std::memory_order_relaxed) != nullptr;
+        }
+        void CollectRemote() {
+            FreeNode* node = remote_free.exchange(nullptr, std::memory_order_acquire);
+            while (node) {
+                Push(std::exchange(node, node->next));
+            }
+        }
+    };
+
+    static constexpr size_t kHeaderSize = (sizeof(Slab) + 63) / 64 * 64;
+
+    class Cache {
+    public:
+        Cache() = default;
+        Cache(const Cache&) = delete;
+        Cache& operator=(const Cache&) = delete;
+
+        // Hands all slabs over to other threads.
+        ~Cache() {
+            for (size_t size_class = 0; size_class < kClasses; ++size_class) {
+                for (Slab** list : {&slabs_[size_class], &full_[size_class]}) {
+                    while (Slab* slab = *list) {
+                        Unlink(slab);
+                        slab->CollectRemote();
+                        if (slab->used == 0) {
+                            Slab::Destroy(slab);
+                            continue;
+                        }
+                        Depot().PutOrphan(slab);
+                    }
+                }
+            }
+        }
+
+        void* Allocate(size_t size_class) {
+            Slab* slab = slabs_[size_class];
+            if (!slab || !slab->HasSpace()) [[unlikely]] {
+                slab = Refill(size_class);
+            }
+            return slab->Pop();
+        }
+        void Free(Slab* slab, void* object) {
+            slab->Push(object);
+            if (slab->full) {
+                Unlink(slab);
+                LinkPartial(slab);
+            } else if (slab->used == 0 && slab != slabs_[slab->size_class]) {
+                Unlink(slab);
+                Slab::Destroy(slab);
+            }
+        }
+
+    private:
+        // Slabs of a class are kept in two lists, the current slab is the head of `slabs_`. Slabs without
+        // space go to `full_` and are not visited on every refill: a full slab comes back on a local free,
+        // or when a scan finds objects on its remote list. The scan runs once the number of slabs added
+        // since the previous one reaches a quarter of the full ones, so its cost is amortized over them.
+        Slab* Refill(size_t size_class) {
+            while (Slab* current = slabs_[size_class]) {
+                current->CollectRemote();
+                if (current->HasSpace()) {
+                    return current;
+                }
+                Unlink(current);
+                LinkFull(current);
+            }
+            if (added_since_scan_[size_class] * kFullScanRatio >= full_count_[size_class]) {
+                added_since_scan_[size_class] = 0;
+                for (Slab* slab = full_[size_class]; slab;) {
+                    Slab* next = slab->next;
+                    if (slab->HasRemote()) {
+                        slab->CollectRemote();
+                        Unlink(slab);
+                        LinkPartial(slab);
+                    }
+                    slab = next;
+                }
+                if (slabs_[size_class]) {
+                    return slabs_[size_class];
+                }
+            }
+            ++added_since_scan_[size_class];
+            while (Slab* slab = Depot().Adopt(this, size_class)) {
+                if (slab->HasSpace()) {
+                    LinkPartial(slab);
+                    return slab;
+                }
+                LinkFull(slab);
+            }
+            Slab* slab = Slab::Create(this, size_class);
+            LinkPartial(slab);
+            return slab;
+        }
+
+        void LinkFront(Slab* slab) {
+            Slab*& head = slab->full ? full_[slab->size_class] : slabs_[slab->size_class];
+            slab->prev = nullptr;
+            slab->next = head;
+            if (head) {
+                head->prev = slab;
+            }
+            head = slab;
+        }
+        void LinkPartial(Slab* slab) {
+            slab->full = false;
+            LinkFront(slab);
+        }
+        void LinkFull(Slab* slab) {
+            slab->full = true;
+            ++full_count_[slab->size_class];
+            LinkFront(slab);
+        }
+        void Unlink(Slab* slab) {
+            if (slab->prev) {
+                slab->prev->next = slab->next;
+            } else if (slab->full) {
+                full_[slab->size_class] = slab->next;
+            } else {
+                slabs_[slab->size_class] = slab->next;
+            }
+            if (slab->next) {
+                slab->next->prev = slab->prev;
+            }
+            slab->prev = slab->next = nullptr;
+            if (slab->full) {
+                --full_count_[slab->size_class];
+            }
+        }
+
+        static constexpr size_t kFullScanRatio = 4;
+
+        Slab* slabs_[kClasses] = {};
+        Slab* full_[kClasses] = {};
+        size_t full_count_[kClasses] = {};
+        size_t added_since_scan_[kClasses] = {};
+    };
+
+    enum CacheState : uint8_t {
+        kUnset,
+        kAlive,
+        kDead,
+    };
+    struct ThreadCache {
+        ThreadCache() {
+            current_cache = &cache;
+            cache_state = kAlive;
+        }
+        ~ThreadCache() {
+            cache_state = kDead;
+            current_cache = nullptr;
+        }
+
+        Cache cache;
+    };
+
+    // Null once the thread has started to exit.
+    static Cache* CurrentCache() {
+        if (cache_state == kAlive) [[likely]] {
+            return current_cache;
+        }
+        if (cache_state == kDead) {
+            return nullptr;
+        }
+        thread_local ThreadCache thread_cache;
+        return current_cache;
+    }
+
+    // Trivially destructible, so still readable while thread-local objects are being destroyed.
+    static inline thread_local CacheState cache_state = kUnset;
+    static inline thread_local Cache* current_cache = nullptr;
+
+    // Shared by all threads: slabs of exited threads, which still have live objects, and a few empty slabs
+    // for reuse. Reuse keeps the footprint down, freshly aligned chunks fragment the global heap.
+    struct SlabDepot {
+        void PutOrphan(Slab* slab) {
+            slab->owner.store(Marker(), std::memory_order_relaxed);
+            std::lock_guard guard(mutex);
+            slab->next = std::exchange(orphans[slab->size_class], slab);
+        }
+        Slab* Adopt(Cache* cache, size_t size_class) {
+            std::lock_guard guard(mutex);
+            Slab* slab = orphans[size_class];
+            if (!slab) {
+                return nullptr;
+            }
+            orphans[size_class] = slab->next;
+            slab->owner.store(cache, std::memory_order_relaxed);
+            slab->CollectRemote();
+            return slab;
+        }
+
+        bool PutSpare(void* memory) {
+            std::lock_guard guard(mutex);
+            if (spare_count == kMaxSpares) {
+                return false;
+            }
+            spares = new (memory) FreeNode{spares};
+            ++spare_count;
+            return true;
+        }
+        void* TakeSpare() {
+            std::lock_guard guard(mutex);
+            if (!spares) {
+                return nullptr;
+            }
+            --spare_count;
+            return std::exchange(spares, spares->next);
+        }
+
+        // Owner of orphans, matches no thread.
+        Cache* Marker() {
+            return reinterpret_cast<Cache*>(this);
+        }
+
+        static constexpr size_t kMaxSpares = 64;
+
+        std::mutex mutex;
+        Slab* orphans[kClasses] = {};
+        FreeNode* spares = nullptr;
+        size_t spare_count = 0;
+    };
+    // Exiting threads allocate from here.
+    struct FallbackCache {
+        std::mutex mutex;
+        Cache cache;
+    };
+
+    // Never destroyed: blocks may be freed during static destruction.
+    static SlabDepot& Depot() {
+        static auto depot = new SlabDepot;
+        return *depot;
+    }
+    static FallbackCache& Fallback() {
+        static auto fallback = new FallbackCache;
+        return *fallback;
+    }
+};
+
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator([[maybe_unused]] const SlabAllocator<U>& other) noexcept {
+    }
+
+    T* allocate(size_t n) {
+        if (n == 1 && SlabHeap::Handles(sizeof(T), alignof(T))) {
+            return static_cast<T*>(SlabHeap::Allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+    void deallocate(T* ptr, size_t n) {
+        if (n == 1 && SlabHeap::Handles(sizeof(T), alignof(T))) {
+            SlabHeap::Deallocate(ptr);
+            return;
+        }
+        ::operator delete(ptr, std::align_val_t(alignof(T)));
+    }
+
+    template <typename U>
+    bool operator==([[maybe_unused]] const SlabAllocator<U>& other) const noexcept {
+        return true;
+    }
+};
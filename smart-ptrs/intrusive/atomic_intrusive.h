@@ -0,0 +1,130 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>
+
+// Slot holding an `IntrusivePtr` that can be loaded and replaced concurrently, e.g. to publish immutable
+// snapshots to many readers. Loads are lock-free and never wait for writers. `T` needs a thread-safe counter
+// (`AtomicCounter`, `AtomicWeakCounter`).
+//
+// Differential reference counting, as in `AtomicSharedPtr`, but without a node per stored value: the slot word
+// keeps the object pointer (low 48 bits) and the number of readers that are taking a reference right now
+// (high 16 bits). A reader announces itself with a single `fetch_add` on the word, increments the object counter
+// and takes the announcement back. A writer adds a reference to the old object for every announced reader
+// before it swaps the object out, so a reader that finds it gone drops that reference instead.
+template <typename T>
+class AtomicIntrusivePtr {
+    static_assert(sizeof(uintptr_t) == 8, "Slot word packing assumes 64-bit pointers");
+
+public:
+    // Constructors
+    AtomicIntrusivePtr() : slot_(0) {
+    }
+    AtomicIntrusivePtr(IntrusivePtr<T> desired) : slot_(ToWord(desired.observer_)) {
+        desired.observer_ = nullptr;  // The slot's reference now
+    }
+
+    AtomicIntrusivePtr(const AtomicIntrusivePtr&) = delete;
+    AtomicIntrusivePtr& operator=(const AtomicIntrusivePtr&) = delete;
+
+    // Destructor
+    ~AtomicIntrusivePtr() {
+        if (T* object = ToObject(slot_.load(std::memory_order_acquire))) {
+            object->DecRef();
+        }
+    }
+
+    // Operations
+    IntrusivePtr<T> Load() const {
+        // Readers of an empty slot have nothing to protect, the count of the empty word is meaningless.
+        if (slot_.load(std::memory_order_relaxed) == 0) {
+            return IntrusivePtr<T>();
+        }
+        T* object = ToObject(slot_.fetch_add(kReaderOne, std::memory_order_acquire));
+        if (!object) {
+            return IntrusivePtr<T>();
+        }
+        IntrusivePtr<T> result(object);  // The announcement keeps the object alive until here
+        Leave(object);
+        return result;
+    }
+    void Store(IntrusivePtr<T> desired) {
+        Exchange(std::move(desired));
+    }
+    IntrusivePtr<T> Exchange(IntrusivePtr<T> desired) {
+        IntrusivePtr<T> old = Load();
+        while (!Replace(old.Get(), desired)) {
+            old = Load();
+        }
+        if (old) {
+            old->DecRef();  // The slot's reference, `old` has its own
+        }
+        return old;
+    }
+
+    // Replaces the value with `desired` if it is the same pointer as `expected`,
+    // otherwise loads the current value into `expected`.
+    bool CompareExchange(IntrusivePtr<T>& expected, IntrusivePtr<T> desired) {
+        if (Replace(expected.Get(), desired)) {
+            if (expected) {
+                expected->DecRef();
+            }
+            return true;
+        }
+        expected = Load();
+        return false;
+    }
+
+private:
+    static constexpr uintptr_t kPointerMask = (uintptr_t{1} << 48) - 1;
+    static constexpr uintptr_t kReaderOne = uintptr_t{1} << 48;
+
+    static T* ToObject(uintptr_t word) {
+        return reinterpret_cast<T*>(word & kPointerMask);
+    }
+    static uintptr_t ToWord(T* object) {
+        return reinterpret_cast<uintptr_t>(object);
+    }
+
+    // Swaps `expected` out for `desired`, which gives its reference to the slot; the slot's reference to `expected`
+    // goes to the caller. The caller holds its own reference to `expected`, so the references added for the
+    // announced readers are safe to take back if the word changes meanwhile.
+    bool Replace(T* expected, IntrusivePtr<T>& desired) {
+        uintptr_t word = slot_.load(std::memory_order_acquire);
+        while (ToObject(word) == expected) {
+            size_t readers = expected ? word >> 48 : 0;
+            for (size_t i = 0; i < readers; ++i) {
+                expected->IncRef();
+            }
+            if (slot_.compare_exchange_weak(word, ToWord(desired.observer_), std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+                desired.observer_ = nullptr;
+                return true;
+            }
+            for (size_t i = 0; i < readers; ++i) {
+                expected->DecRef();
+            }
+        }
+        return false;
+    }
+
+    // Takes our announcement back from the slot, or drops the reference a writer has added for it.
+    // The same object may have been stored again since: an announcement taken from the new word then leaves
+    // a reference added for ours, and whoever misses theirs drops that one. A word without announcements
+    // can't be ours.
+    void Leave(T* object) const {
+        uintptr_t word = slot_.load(std::memory_order_relaxed);
+        while (ToObject(word) == object && (word >> 48) != 0) {
+            if (slot_.compare_exchange_weak(word, word - kReaderOne, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        object->DecRef();
+    }
+
+    mutable std::atomic<uintptr_t> slot_;
+};
@@ -1,24 +1,186 @@
 #pragma once
 
+#include "../stats/stats.h"
+
+#include <atomic>
 #include <cstddef>  // for std::nullptr_t
+#include <cstdlib>  // for std::abort
+#include <limits>
+#include <type_traits>
 #include <utility>  // for std::exchange / std::swap
 
+// Immortal objects (process-lifetime singletons, interned constants) have this count added, so it never drops
+// to zero. See `RefCounted::MakeImmortal()`.
+// With `SMART_PTRS_IMMORTAL_OBJECTS` copies and releases of them don't write the counter at all, which spares
+// the cache-line ping-pong on hot globals; in exchange every counter operation checks for it.
+inline constexpr size_t kImmortalRefCount = size_t{1} << 62;
+
+inline bool IsImmortalRefCount([[maybe_unused]] size_t count) {
+#ifdef SMART_PTRS_IMMORTAL_OBJECTS
+    return count >= kImmortalRefCount;
+#else
+    return false;
+#endif
+}
+
 class SimpleCounter {
 public:
     size_t IncRef() {
+        if (IsImmortalRefCount(count_)) {
+            return count_;
+        }
         return ++count_;
     }
     size_t DecRef() {
+        if (IsImmortalRefCount(count_)) {
+            return count_;
+        }
         return --count_;
     }
     size_t RefCount() const {
         return count_;
     }
+    // Existing references stay counted
+    void MakeImmortal() {
+        count_ += kImmortalRefCount;
+    }
 
 private:
     size_t count_ = 0;
 };
 
+// Thread-safe counter. A new reference is always made from an existing one, which keeps the object alive,
+// so increments are relaxed. Decrements release our writes to the object and acquire everyone else's before it is
+// destroyed.
+class AtomicCounter {
+public:
+    size_t IncRef() {
+        size_t count = count_.load(std::memory_order_relaxed);
+        if (IsImmortalRefCount(count)) {
+            return count;
+        }
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    size_t DecRef() {
+        size_t count = count_.load(std::memory_order_acquire);
+        // The caller holds the only reference: nobody else can touch the counter, no read-modify-write needed
+        if (count == 1) {
+            count_.store(0, std::memory_order_relaxed);
+            return 0;
+        }
+        if (IsImmortalRefCount(count)) {
+            return count;
+        }
+        return count_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+    void MakeImmortal() {
+        count_.fetch_add(kImmortalRefCount, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> count_ = 0;
+};
+
+// What narrow counters do when the count doesn't fit anymore
+enum class RefCountOverflow {
+    kSaturate,  // The object becomes immortal: it is leaked rather than destroyed too early
+    kTrap,      // std::abort()
+};
+
+template <RefCountOverflow Overflow>
+void OnRefCountOverflow() {
+    if constexpr (Overflow == RefCountOverflow::kTrap) {
+        std::abort();
+    }
+}
+
+// Counters of `Int` width for small objects that never have many references, e.g. `NarrowCounter<uint16_t>`
+// saves 6 bytes per object compared to `SimpleCounter`. A quarter of the range plays the part of
+// `kImmortalRefCount`, and a count that grows up to it is saturated there: the object is immortal from then on.
+// So narrow counters always check for immortal objects, with or without `SMART_PTRS_IMMORTAL_OBJECTS`.
+template <typename Int, RefCountOverflow Overflow = RefCountOverflow::kSaturate>
+class NarrowCounter {
+    static_assert(std::is_unsigned_v<Int>);
+
+public:
+    static constexpr Int kImmortal = Int{1} << (std::numeric_limits<Int>::digits - 2);
+
+    size_t IncRef() {
+        if (count_ >= kImmortal) {
+            return count_;
+        }
+        if (++count_ == kImmortal) {
+            OnRefCountOverflow<Overflow>();
+        }
+        return count_;
+    }
+    size_t DecRef() {
+        if (count_ >= kImmortal) {
+            return count_;
+        }
+        return --count_;
+    }
+    size_t RefCount() const {
+        return count_;
+    }
+    void MakeImmortal() {
+        count_ += kImmortal;
+    }
+
+private:
+    Int count_ = 0;
+};
+
+// `AtomicCounter` of `Int` width, saturates as `NarrowCounter`
+template <typename Int, RefCountOverflow Overflow = RefCountOverflow::kSaturate>
+class AtomicNarrowCounter {
+    static_assert(std::is_unsigned_v<Int>);
+
+public:
+    static constexpr Int kImmortal = NarrowCounter<Int, Overflow>::kImmortal;
+
+    size_t IncRef() {
+        Int count = count_.load(std::memory_order_relaxed);
+        if (count >= kImmortal) {
+            return count;
+        }
+        Int result = count_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (result == kImmortal) {
+            OnRefCountOverflow<Overflow>();
+        }
+        return result;
+    }
+    size_t DecRef() {
+        Int count = count_.load(std::memory_order_acquire);
+        if (count == 1) {
+            count_.store(0, std::memory_order_relaxed);
+            return 0;
+        }
+        if (count >= kImmortal) {
+            return count;
+        }
+        Int previous = count_.fetch_sub(1, std::memory_order_acq_rel);
+        // Saturated by other threads meanwhile: the count mustn't go down anymore
+        if (previous >= kImmortal) {
+            count_.fetch_add(1, std::memory_order_relaxed);
+            return previous;
+        }
+        return previous - 1;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+    void MakeImmortal() {
+        count_.fetch_add(kImmortal, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<Int> count_ = 0;
+};
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
@@ -31,12 +193,14 @@ class RefCounted {
 public:
     // Increase reference counter.
     void IncRef() {
+        TrackStats<Derived>::OnIncrement();
         counter_.IncRef();
     }
 
     // Decrease reference counter.
     // Destroy object using Deleter when the last instance dies.
     void DecRef() {
+        TrackStats<Derived>::OnDecrement();
         if (counter_.DecRef() == 0) {
             Deleter::Destroy(static_cast<Derived*>(this));
         }
@@ -47,12 +211,26 @@ public:
         return counter_.RefCount();
     }
 
+    // The object is never destroyed, see `kImmortalRefCount`. Works for objects that aren't on the heap too,
+    // e.g. for a static one before it is first pointed to. Call it before the object is shared with other threads.
+    void MakeImmortal() {
+        counter_.MakeImmortal();
+    }
+
+    // Registers a weak reference, only with counters that support them (see weak.h).
+    auto* AcquireWeakRefs() {
+        return counter_.AcquireWeakRefs();
+    }
+
     RefCounted() {
+        TrackStats<Derived>::OnCreate(sizeof(Derived));
     }
     // Lots of boilerplate to avoid UB.
     RefCounted([[maybe_unused]] const RefCounted& other) {
+        TrackStats<Derived>::OnCreate(sizeof(Derived));
     }
     RefCounted([[maybe_unused]] const RefCounted&& other) {
+        TrackStats<Derived>::OnCreate(sizeof(Derived));
     }
     RefCounted& operator=([[maybe_unused]] const RefCounted& other) {
         return *this;
@@ -61,6 +239,11 @@ public:
         return *this;
     }
     // virtual ~RefCounted() = default;
+#ifdef SMART_PTRS_STATS
+    ~RefCounted() {
+        TrackStats<Derived>::OnDestroy(sizeof(Derived));
+    }
+#endif
 
 private:
     Counter counter_;
@@ -69,10 +252,23 @@ private:
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+template <typename Derived, typename D = DefaultDelete>
+using SimpleAtomicRefCounted = RefCounted<Derived, AtomicCounter, D>;
+
+template <typename T>
+class IntrusiveWeakPtr;
+
+template <typename T>
+class AtomicIntrusivePtr;
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
     friend class IntrusivePtr;
+    template <typename Y>
+    friend class IntrusiveWeakPtr;
+    template <typename Y>
+    friend class AtomicIntrusivePtr;
 
 public:
     // Constructors
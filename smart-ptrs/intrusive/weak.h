@@ -0,0 +1,241 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // uintptr_t
+#include <type_traits>
+#include <utility>  // std::exchange / std::swap
+
+// Weak references to intrusive objects without a control block for every object.
+// `AtomicWeakCounter` is a single word: the strong count, until the first weak reference allocates
+// a `WeakRefTable` and the word is tagged to point to it. The table keeps both counts from then on,
+// and outlives the object while there are weak references to it.
+//
+//     struct Entry : WeakRefCounted<Entry> { ... };
+//     IntrusiveWeakPtr<Entry> weak = entry;
+//     if (auto locked = weak.Lock()) { ... }
+
+class WeakRefTable {
+public:
+    // The object holds a weak reference until it's destroyed, the first `IntrusiveWeakPtr` another one
+    explicit WeakRefTable(size_t strong) : strong_(strong), weak_(2) {
+    }
+
+    size_t IncRef() {
+        if (IsImmortal()) {
+            return RefCount();
+        }
+        return strong_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    // Once zero, the count stays so: `Lock()` can't revive an object that is being destroyed.
+    bool TryIncRef() {
+        size_t strong = strong_.load(std::memory_order_relaxed);
+        do {
+            if (strong == 0) {
+                return false;
+            }
+            if (IsImmortalRefCount(strong)) {
+                return true;
+            }
+        } while (!strong_.compare_exchange_weak(strong, strong + 1, std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return true;
+    }
+    size_t DecRef() {
+        if (IsImmortal()) {
+            return RefCount();
+        }
+        return strong_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+    size_t RefCount() const {
+        return strong_.load(std::memory_order_relaxed);
+    }
+    void MakeImmortal() {
+        strong_.fetch_add(kImmortalRefCount, std::memory_order_relaxed);
+    }
+
+    void IncWeakRef() {
+        weak_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Deletes the table with the last weak reference
+    void DecWeakRef() {
+        if (weak_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+private:
+    // No load at all unless `SMART_PTRS_IMMORTAL_OBJECTS` is defined
+    bool IsImmortal() const {
+#ifdef SMART_PTRS_IMMORTAL_OBJECTS
+        return IsImmortalRefCount(RefCount());
+#else
+        return false;
+#endif
+    }
+
+    std::atomic<size_t> strong_;
+    std::atomic<size_t> weak_;
+};
+
+// Thread-safe, as `AtomicCounter`. Without a table the strong count is shifted by one bit, the low bit tags
+// a table pointer. Increments are CAS loops rather than `fetch_add`: the word may turn into a pointer meanwhile.
+class AtomicWeakCounter {
+public:
+    AtomicWeakCounter() = default;
+    AtomicWeakCounter(const AtomicWeakCounter&) = delete;
+    AtomicWeakCounter& operator=(const AtomicWeakCounter&) = delete;
+
+    // The object is destroyed: weak references see it expired, the table stays until they are gone
+    ~AtomicWeakCounter() {
+        if (auto table = Table(word_.load(std::memory_order_acquire))) {
+            table->DecWeakRef();
+        }
+    }
+
+    size_t IncRef() {
+        uintptr_t word = word_.load(std::memory_order_acquire);
+        if (IsImmortalRefCount(word >> 1)) {
+            return word >> 1;
+        }
+        while (!(word & kTagged)) {
+            // Acquire on failure: the word may have become a pointer to a table just initialized
+            if (word_.compare_exchange_weak(word, word + kOne, std::memory_order_acquire)) {
+                return (word >> 1) + 1;
+            }
+        }
+        return Table(word)->IncRef();
+    }
+    size_t DecRef() {
+        uintptr_t word = word_.load(std::memory_order_acquire);
+        // The only reference and no weak ones: nobody else can touch the counter
+        if (word == kOne) {
+            word_.store(0, std::memory_order_relaxed);
+            return 0;
+        }
+        if (IsImmortalRefCount(word >> 1)) {
+            return word >> 1;
+        }
+        while (!(word & kTagged)) {
+            if (word_.compare_exchange_weak(word, word - kOne, std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+                return (word >> 1) - 1;
+            }
+        }
+        return Table(word)->DecRef();
+    }
+    size_t RefCount() const {
+        uintptr_t word = word_.load(std::memory_order_acquire);
+        return word & kTagged ? Table(word)->RefCount() : word >> 1;
+    }
+
+    // Before the object is shared with other threads: the word must not turn into a table meanwhile
+    void MakeImmortal() {
+        uintptr_t word = word_.load(std::memory_order_acquire);
+        if (auto table = Table(word)) {
+            table->MakeImmortal();
+        } else {
+            word_.store(word + kImmortalWord, std::memory_order_relaxed);
+        }
+    }
+
+    // The caller holds a strong reference, so the count can't drop to zero meanwhile.
+    // An immortal count goes to the table as it is.
+    WeakRefTable* AcquireWeakRefs() {
+        uintptr_t word = word_.load(std::memory_order_acquire);
+        while (!(word & kTagged)) {
+            auto table = new WeakRefTable(word >> 1);
+            if (word_.compare_exchange_strong(word, reinterpret_cast<uintptr_t>(table) | kTagged,
+                                              std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return table;
+            }
+            delete table;  // The strong count has changed, or another thread has installed its table
+        }
+        Table(word)->IncWeakRef();
+        return Table(word);
+    }
+
+private:
+    static constexpr uintptr_t kTagged = 1;
+    static constexpr uintptr_t kOne = 2;
+    static constexpr uintptr_t kImmortalWord = kImmortalRefCount << 1;
+
+    static WeakRefTable* Table(uintptr_t word) {
+        return word & kTagged ? reinterpret_cast<WeakRefTable*>(word & ~kTagged) : nullptr;
+    }
+
+    std::atomic<uintptr_t> word_ = 0;
+};
+
+template <typename Derived, typename D = DefaultDelete>
+using WeakRefCounted = RefCounted<Derived, AtomicWeakCounter, D>;
+
+// https://en.cppreference.com/w/cpp/memory/weak_ptr, for `RefCounted` objects with `AtomicWeakCounter`
+template <typename T>
+class IntrusiveWeakPtr {
+public:
+    // Constructors
+    IntrusiveWeakPtr() : observer_(nullptr), table_(nullptr) {
+    }
+    IntrusiveWeakPtr(const IntrusivePtr<T>& ptr)
+        : observer_(ptr.Get()), table_(observer_ ? observer_->AcquireWeakRefs() : nullptr) {
+    }
+    IntrusiveWeakPtr(const IntrusiveWeakPtr& other) : observer_(other.observer_), table_(other.table_) {
+        if (table_) {
+            table_->IncWeakRef();
+        }
+    }
+    IntrusiveWeakPtr(IntrusiveWeakPtr&& other)
+        : observer_(std::exchange(other.observer_, nullptr)), table_(std::exchange(other.table_, nullptr)) {
+    }
+
+    // Copy-and-swap operator=, as in `IntrusivePtr`
+    IntrusiveWeakPtr& operator=(IntrusiveWeakPtr other) {
+        this->Swap(other);
+        return *this;
+    }
+
+    // Destructor
+    ~IntrusiveWeakPtr() {
+        if (table_) {
+            table_->DecWeakRef();
+        }
+    }
+
+    // Modifiers
+    void Reset() {
+        observer_ = nullptr;
+        if (auto table = std::exchange(table_, nullptr)) {
+            table->DecWeakRef();
+        }
+    }
+    void Swap(IntrusiveWeakPtr& other) {
+        std::swap(observer_, other.observer_);
+        std::swap(table_, other.table_);
+    }
+
+    // Observers
+    size_t UseCount() const {
+        return table_ ? table_->RefCount() : 0;
+    }
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+    // Single "increment if not zero", as `WeakPtr::Lock()`
+    IntrusivePtr<T> Lock() const {
+        using Tracked = std::remove_cv_t<T>;
+        IntrusivePtr<T> result;
+        if (table_ && table_->TryIncRef()) {
+            TrackStats<Tracked>::OnIncrement();
+            result.observer_ = observer_;
+        }
+        TrackStats<Tracked>::OnLock(result.observer_ != nullptr);
+        return result;
+    }
+
+private:
+    T* observer_;
+    WeakRefTable* table_;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "../intrusive/intrusive.h"
+#include "../shared/ref_counters.h"
+
+#include <atomic>
+#include <bit>  // std::bit_ceil
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Destruction off the latency-critical threads: an object whose last reference is gone is put into a bounded
+// lock-free queue and destroyed, with everything it owns, by a background reclaimer thread.
+// The releasing thread pays for a single enqueue, whatever the size of the object graph.
+//
+// When the queue is full, the releasing thread either destroys the object itself (`kDestroyInline`, default)
+// or waits for a free slot (`kWait`). `GetStats()` shows the queue depth and how often that happens.
+//
+// Both families can release through the default reclaimer:
+//  * `SharedPtr`: pointee derives from `ReleasedWith<BackgroundRelease>`;
+//  * `IntrusivePtr`: `RefCounted<Derived, Counter, BackgroundDelete<Deleter>>`.
+// Destructors run on the reclaimer thread, so every counter they touch has to be thread-safe: `SharedPtr` needs
+// `SMART_PTRS_ATOMIC_REFCOUNT` or `SMART_PTRS_BIASED_REFCOUNT` (checked by `BackgroundRelease`), intrusive objects
+// reachable from a retired one need an atomic counter like `AtomicCounter` (not checked).
+// With `SMART_PTRS_BIASED_REFCOUNT` references the reclaimer drops for another thread are merged by that thread,
+// so it still has to call `MergeBiasedRefCounts()` from time to time.
+class BackgroundReclaimer {
+public:
+    enum class Overflow {
+        kDestroyInline,
+        kWait,
+    };
+
+    struct Stats {
+        size_t depth = 0;  // Queued or being reclaimed
+        size_t max_depth = 0;
+        uint64_t reclaimed = 0;  // Including everything the queued objects owned
+        uint64_t batches = 0;
+        uint64_t overflows = 0;  // Releases that found the queue full
+    };
+
+    static constexpr size_t kDefaultCapacity = 1 << 14;
+
+    explicit BackgroundReclaimer(size_t capacity = kDefaultCapacity, Overflow overflow = Overflow::kDestroyInline)
+        : capacity_(std::bit_ceil(capacity)),
+          overflow_(overflow),
+          cells_(std::make_unique<Cell[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        thread_ = std::thread([this] { Run(); });
+    }
+    BackgroundReclaimer(const BackgroundReclaimer&) = delete;
+    BackgroundReclaimer& operator=(const BackgroundReclaimer&) = delete;
+
+    // Everything queued is reclaimed before the thread stops.
+    ~BackgroundReclaimer() {
+        stopping_.store(true, std::memory_order_release);
+        Wake();
+        thread_.join();
+    }
+
+    static BackgroundReclaimer& Default() {
+        static BackgroundReclaimer reclaimer;
+        return reclaimer;
+    }
+
+    // `reclaim(object)` is called on the reclaimer thread.
+    void Retire(void* object, void (*reclaim)(void*)) {
+        if (current_reclaimer == this) {
+            cascade_.push_back({object, reclaim});  // Released by a queued object: no recursion, no queue slot
+            return;
+        }
+        // Counted before the push: once the cell is published the reclaimer may pop it and decrement right away.
+        // The push itself orders the increment before that decrement.
+        size_t depth = depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!TryPush({object, reclaim})) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            if (overflow_ == Overflow::kDestroyInline) {
+                depth_.fetch_sub(1, std::memory_order_relaxed);
+                reclaim(object);
+                return;
+            }
+            do {
+                std::this_thread::yield();
+            } while (!TryPush({object, reclaim}));
+        }
+        if (depth == 1) {
+            Wake();
+        }
+        size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+        while (max_depth < depth &&
+               !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Waits until everything retired so far is reclaimed. Not on the reclaimer thread.
+    void Flush() {
+        while (depth_.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    Stats GetStats() const {
+        Stats stats;
+        stats.depth = depth_.load(std::memory_order_relaxed);
+        stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+        stats.reclaimed = reclaimed_.load(std::memory_order_relaxed);
+        stats.batches = batches_.load(std::memory_order_relaxed);
+        stats.overflows = overflows_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Retired {
+        void* object;
+        void (*reclaim)(void*);
+    };
+    // Bounded queue of D. Vyukov: the sequence number of a cell tells whose turn it is,
+    // producers only contend on `enqueue_position_`.
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Retired retired;
+    };
+
+    static constexpr size_t kMaxBatch = 256;
+
+    bool TryPush(Retired retired) {
+        size_t position = enqueue_position_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[position & (capacity_ - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.retired = retired;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;  // Full: the consumer hasn't freed the cell of the previous lap
+            } else {
+                position = enqueue_position_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    // Reclaimer thread only
+    bool TryPop(Retired& retired) {
+        Cell& cell = cells_[dequeue_position_ & (capacity_ - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1) {
+            return false;
+        }
+        retired = cell.retired;
+        cell.sequence.store(dequeue_position_ + capacity_, std::memory_order_release);
+        ++dequeue_position_;
+        return true;
+    }
+
+    void Wake() {
+        wake_.fetch_add(1, std::memory_order_release);
+        wake_.notify_one();
+    }
+
+    void Run() {
+        current_reclaimer = this;
+
+        while (true) {
+            uint32_t wake = wake_.load(std::memory_order_acquire);
+            size_t batch = 0;
+            uint64_t reclaimed = 0;
+            Retired retired;
+            while (batch < kMaxBatch && TryPop(retired)) {
+                reclaimed += Reclaim(retired);
+                ++batch;
+            }
+            if (batch != 0) {
+                reclaimed_.fetch_add(reclaimed, std::memory_order_relaxed);
+                batches_.fetch_add(1, std::memory_order_relaxed);
+                depth_.fetch_sub(batch, std::memory_order_release);
+                continue;
+            }
+            if (depth_.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();  // A producer has counted an object but hasn't filled its cell yet
+            } else if (stopping_.load(std::memory_order_acquire)) {
+                return;
+            } else {
+                wake_.wait(wake, std::memory_order_acquire);
+            }
+        }
+    }
+
+    // Objects released by destructors here are reclaimed in a loop, not recursively
+    uint64_t Reclaim(Retired retired) {
+        uint64_t reclaimed = 1;
+        retired.reclaim(retired.object);
+        while (!cascade_.empty()) {
+            Retired next = cascade_.back();
+            cascade_.pop_back();
+            next.reclaim(next.object);
+            ++reclaimed;
+        }
+        return reclaimed;
+    }
+
+    static inline thread_local BackgroundReclaimer* current_reclaimer = nullptr;
+
+    const size_t capacity_;
+    const Overflow overflow_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(64) std::atomic<size_t> enqueue_position_ = 0;
+    alignas(64) size_t dequeue_position_ = 0;  // Reclaimer thread only
+    std::vector<Retired> cascade_;  // Reclaimer thread only
+
+    alignas(64) std::atomic<size_t> depth_ = 0;
+    std::atomic<size_t> max_depth_ = 0;
+    std::atomic<uint32_t> wake_ = 0;
+    std::atomic<bool> stopping_ = false;
+
+    std::atomic<uint64_t> reclaimed_ = 0;
+    std::atomic<uint64_t> batches_ = 0;
+    std::atomic<uint64_t> overflows_ = 0;
+
+    std::thread thread_;
+};
+
+// Dependent on the object type, so that plain counters are rejected only where `SharedPtr` objects are released here
+template <typename>
+inline constexpr bool kThreadSafeSharedCounters = !std::is_same_v<SharedRefCounter, SimpleSharedCounter>;
+
+// `SharedPtr` release policy: the control block and the object go to the default reclaimer.
+struct BackgroundRelease {
+    template <typename Object>
+    static bool Release([[maybe_unused]] const Object* object, void* block, void (*finish)(void*)) {
+        static_assert(kThreadSafeSharedCounters<Object>,
+                      "BackgroundRelease destroys objects on another thread: define SMART_PTRS_ATOMIC_REFCOUNT "
+                      "or SMART_PTRS_BIASED_REFCOUNT");
+        BackgroundReclaimer::Default().Retire(block, finish);
+        return false;
+    }
+};
+
+// `RefCounted` deleter: the object goes to the default reclaimer, then `Deleter` destroys it.
+template <typename Deleter = DefaultDelete>
+struct BackgroundDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        BackgroundReclaimer::Default().Retire(object,
+                                              [](void* retired) { Deleter::Destroy(static_cast<T*>(retired)); });
+    }
+};
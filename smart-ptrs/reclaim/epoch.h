@@ -0,0 +1,292 @@
+#pragma once
+
+#include "../intrusive/intrusive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <mutex>
+#include <utility>  // std::exchange
+#include <vector>
+
+// Epoch-based reclamation, see "Practical lock-freedom" by K. Fraser.
+// Readers enter an epoch section with `EpochGuard` and may hold raw pointers inside it for free.
+// Retired objects wait in a per-thread limbo list and are freed in batches once every thread has left
+// the sections that could have seen them (passed a quiescent point): the global epoch has advanced twice.
+//
+// Both families can release through the domain:
+//  * `SharedPtr`: pointee derives from `ReleasedWith<EpochRelease>`;
+//  * `IntrusivePtr`: `RefCounted<Derived, Counter, EpochDelete<Deleter>>`.
+// Threads using a domain must exit before it is destroyed.
+class EpochDomain {
+public:
+    struct Stats {
+        size_t limbo_size = 0;  // Retired, not reclaimed yet
+        uint64_t reclaimed = 0;
+        uint64_t reclaim_latency_avg_ns = 0;  // From `Retire` to reclamation
+        uint64_t reclaim_latency_max_ns = 0;
+    };
+
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Destructors run here may retire more objects. Thread records may be gone by now (the default domain
+    // outlives `thread_local`s), so such retires go straight to `draining_` and are reclaimed in the same loop.
+    ~EpochDomain() {
+        std::vector<Retired> draining;
+        for (Record* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+            draining.insert(draining.end(), record->limbo.begin(), record->limbo.end());
+            record->limbo.clear();
+        }
+        draining.insert(draining.end(), orphans_.begin(), orphans_.end());
+        orphans_.clear();
+
+        draining_ = &draining;
+        while (!draining.empty()) {
+            std::vector<Retired> batch;
+            batch.swap(draining);
+            ReclaimAll(batch);
+        }
+        draining_ = nullptr;
+
+        for (Record* record = records_.load(std::memory_order_acquire); record;) {
+            delete std::exchange(record, record->next);
+        }
+    }
+
+    static EpochDomain& Default() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void Enter() {
+        if (draining_) {
+            return;
+        }
+        Record* record = CurrentRecord();
+        if (record->nesting++ == 0) {
+            record->epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+            // The announcement must be visible before the reader loads any shared pointer, otherwise a writer
+            // may advance past this record and reclaim what the reader is about to use.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    void Leave() {
+        if (draining_) {
+            return;
+        }
+        Record* record = CurrentRecord();
+        if (--record->nesting == 0) {
+            record->epoch.store(kQuiescent, std::memory_order_release);
+        }
+    }
+
+    // `reclaim(object)` is called once no thread can be in a section that has seen the object.
+    void Retire(void* object, void (*reclaim)(void*)) {
+        if (draining_) {
+            draining_->push_back({object, reclaim, 0, Clock::now()});
+            limbo_size_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record* record = CurrentRecord();
+        record->limbo.push_back({object, reclaim, epoch_.load(std::memory_order_seq_cst), Clock::now()});
+        limbo_size_.fetch_add(1, std::memory_order_relaxed);
+        if (record->limbo.size() >= kReclaimBatch) {
+            TryAdvance();
+            ReclaimReady(record);
+        }
+    }
+
+    // Advances the epoch as far as readers allow and reclaims everything it can, including leftovers
+    // of exited threads.
+    void Flush() {
+        TryAdvance();
+        TryAdvance();
+        ReclaimReady(CurrentRecord());
+    }
+
+    Stats GetStats() const {
+        Stats stats;
+        stats.limbo_size = limbo_size_.load(std::memory_order_relaxed);
+        stats.reclaimed = reclaimed_.load(std::memory_order_relaxed);
+        if (stats.reclaimed != 0) {
+            stats.reclaim_latency_avg_ns = latency_sum_ns_.load(std::memory_order_relaxed) / stats.reclaimed;
+        }
+        stats.reclaim_latency_max_ns = latency_max_ns_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Retired {
+        void* object;
+        void (*reclaim)(void*);
+        uint64_t epoch;
+        Clock::time_point retired_at;
+    };
+    struct Record {
+        std::atomic<uint64_t> epoch = kQuiescent;
+        std::atomic<bool> active = true;
+        Record* next = nullptr;
+        // Touched by the owning thread only
+        size_t nesting = 0;
+        std::vector<Retired> limbo;
+    };
+
+    // Releases records of an exiting thread, its limbo goes to `orphans_`.
+    class ThreadRecords {
+    public:
+        ~ThreadRecords() {
+            for (auto [domain, record] : records) {
+                domain->ReleaseRecord(record);
+            }
+        }
+
+        std::vector<std::pair<EpochDomain*, Record*>> records;
+    };
+
+    static constexpr uint64_t kQuiescent = 0;
+    static constexpr size_t kReclaimBatch = 64;
+
+    Record* CurrentRecord() {
+        thread_local ThreadRecords thread_records;
+        for (auto [domain, record] : thread_records.records) {
+            if (domain == this) {
+                return record;
+            }
+        }
+        Record* record = AcquireRecord();
+        thread_records.records.emplace_back(this, record);
+        return record;
+    }
+
+    Record* AcquireRecord() {
+        for (Record* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+            bool active = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                record->active.compare_exchange_strong(active, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        auto record = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+        return record;
+    }
+    void ReleaseRecord(Record* record) {
+        {
+            std::lock_guard guard(orphans_mutex_);
+            orphans_.insert(orphans_.end(), record->limbo.begin(), record->limbo.end());
+        }
+        record->limbo.clear();
+        record->nesting = 0;
+        record->epoch.store(kQuiescent, std::memory_order_release);
+        record->active.store(false, std::memory_order_release);
+    }
+
+    // The epoch moves on only when every thread inside a section has observed the current one.
+    void TryAdvance() {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        for (Record* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+            uint64_t observed = record->epoch.load(std::memory_order_seq_cst);
+            if (observed != kQuiescent && observed != epoch) {
+                return;
+            }
+        }
+        epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    bool IsReady(const Retired& retired, uint64_t epoch) const {
+        return retired.epoch + 2 <= epoch;
+    }
+
+    void ReclaimReady(Record* record) {
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        // Limbo is ordered by epoch. Ready entries are moved out first: reclaiming may retire more objects.
+        auto ready_end = std::find_if(record->limbo.begin(), record->limbo.end(),
+                                      [&](const Retired& retired) { return !IsReady(retired, epoch); });
+        std::vector<Retired> ready(record->limbo.begin(), ready_end);
+        record->limbo.erase(record->limbo.begin(), ready_end);
+
+        if (orphans_mutex_.try_lock()) {
+            auto orphans_end = std::partition(orphans_.begin(), orphans_.end(),
+                                              [&](const Retired& retired) { return IsReady(retired, epoch); });
+            ready.insert(ready.end(), orphans_.begin(), orphans_end);
+            orphans_.erase(orphans_.begin(), orphans_end);
+            orphans_mutex_.unlock();
+        }
+        ReclaimAll(ready);
+    }
+
+    void ReclaimAll(std::vector<Retired>& retired_objects) {
+        auto now = Clock::now();
+        uint64_t latency_sum = 0;
+        uint64_t latency_max = 0;
+        for (auto& retired : retired_objects) {
+            uint64_t latency = std::chrono::nanoseconds(now - retired.retired_at).count();
+            latency_sum += latency;
+            latency_max = std::max(latency_max, latency);
+            retired.reclaim(retired.object);
+        }
+        limbo_size_.fetch_sub(retired_objects.size(), std::memory_order_relaxed);
+        reclaimed_.fetch_add(retired_objects.size(), std::memory_order_relaxed);
+        latency_sum_ns_.fetch_add(latency_sum, std::memory_order_relaxed);
+        uint64_t current_max = latency_max_ns_.load(std::memory_order_relaxed);
+        while (current_max < latency_max &&
+               !latency_max_ns_.compare_exchange_weak(current_max, latency_max, std::memory_order_relaxed)) {
+        }
+        retired_objects.clear();
+    }
+
+    std::atomic<uint64_t> epoch_ = 1;
+    std::atomic<Record*> records_ = nullptr;
+    std::vector<Retired>* draining_ = nullptr;  // Set by the destructor only
+
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;  // Guarded by `orphans_mutex_`
+
+    std::atomic<size_t> limbo_size_ = 0;
+    std::atomic<uint64_t> reclaimed_ = 0;
+    std::atomic<uint64_t> latency_sum_ns_ = 0;
+    std::atomic<uint64_t> latency_max_ns_ = 0;
+};
+
+// Epoch section of the current thread, sections nest.
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochDomain& domain = EpochDomain::Default()) : domain_(domain) {
+        domain_.Enter();
+    }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard() {
+        domain_.Leave();
+    }
+
+private:
+    EpochDomain& domain_;
+};
+
+// `SharedPtr` release policy: the control block and the object wait in the default domain.
+struct EpochRelease {
+    static bool Release([[maybe_unused]] const void* object, void* block, void (*finish)(void*)) {
+        EpochDomain::Default().Retire(block, finish);
+        return false;
+    }
+};
+
+// `RefCounted` deleter: the object waits in the default domain, then `Deleter` destroys it.
+template <typename Deleter = DefaultDelete>
+struct EpochDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        EpochDomain::Default().Retire(object, [](void* retired) { Deleter::Destroy(static_cast<T*>(retired)); });
+    }
+};
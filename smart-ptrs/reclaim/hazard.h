@@ -0,0 +1,194 @@
+#pragma once
+
+#include "../intrusive/intrusive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>  // size_t
+#include <utility>  // std::exchange
+#include <vector>
+
+// Hazard pointers, see "Hazard Pointers: Safe Memory Reclamation for Lock-Free Objects" by M. Michael.
+// A reader announces the raw pointer it is going to use in a hazard slot and takes no reference.
+// Retired objects are reclaimed only when no slot covers them.
+//
+// Both families can release through the domain:
+//  * `SharedPtr`: pointee derives from `ReleasedWith<HazardRelease>`;
+//  * `IntrusivePtr`: `RefCounted<Derived, Counter, HazardDelete<Deleter>>`.
+// Writers unpublish the pointer first (e.g. replace it in an `std::atomic<T*>`) and drop their reference after.
+class HazardDomain {
+public:
+    HazardDomain() = default;
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    // Nobody may use the domain anymore, so everything left is reclaimed. Destructors run here may retire more
+    // objects, so the list is taken again until it stays empty; records are deleted only after that.
+    ~HazardDomain() {
+        while (Retired* list = retired_.exchange(nullptr, std::memory_order_acquire)) {
+            ReclaimList(list, {});
+        }
+        for (Record* record = records_.load(std::memory_order_acquire); record;) {
+            delete std::exchange(record, record->next);
+        }
+    }
+
+    static HazardDomain& Default() {
+        static HazardDomain domain;
+        return domain;
+    }
+
+    // `reclaim(object)` is called once no hazard slot holds `key` (the pointer readers protect).
+    void Retire(const void* key, void* object, void (*reclaim)(void*)) {
+        Push(new Retired{key, object, reclaim, nullptr});
+        if (retired_count_.fetch_add(1, std::memory_order_relaxed) + 1 >= ReclaimThreshold()) {
+            Reclaim();
+        }
+    }
+    void Retire(void* object, void (*reclaim)(void*)) {
+        Retire(object, object, reclaim);
+    }
+
+    // Scans hazard slots and reclaims all retired objects that are not protected.
+    void Reclaim() {
+        Retired* list = retired_.exchange(nullptr, std::memory_order_acquire);
+        if (!list) {
+            return;
+        }
+        // Sequentially consistent, as in `HazardPointer::Protect`: either we see the hazard,
+        // or the reader sees that the pointer has been unpublished.
+        std::vector<const void*> hazards;
+        for (Record* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+            if (auto pointer = record->pointer.load(std::memory_order_seq_cst)) {
+                hazards.push_back(pointer);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        ReclaimList(list, hazards);
+    }
+
+    size_t RetiredCount() const {
+        return retired_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Record {
+        std::atomic<const void*> pointer = nullptr;
+        std::atomic<bool> active = true;
+        Record* next = nullptr;
+    };
+    struct Retired {
+        const void* key;
+        void* object;
+        void (*reclaim)(void*);
+        Retired* next;
+    };
+
+    static constexpr size_t kMinReclaimBatch = 64;
+
+    // Amortizes the scan: at least half of the batch is guaranteed to be reclaimed.
+    size_t ReclaimThreshold() const {
+        return std::max(kMinReclaimBatch, 2 * record_count_.load(std::memory_order_relaxed));
+    }
+
+    Record* AcquireRecord() {
+        for (Record* record = records_.load(std::memory_order_acquire); record; record = record->next) {
+            bool active = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                record->active.compare_exchange_strong(active, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        auto record = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+        record_count_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+    void ReleaseRecord(Record* record) {
+        record->pointer.store(nullptr, std::memory_order_release);
+        record->active.store(false, std::memory_order_release);
+    }
+
+    void Push(Retired* retired) {
+        retired->next = retired_.load(std::memory_order_relaxed);
+        while (!retired_.compare_exchange_weak(retired->next, retired, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+    void ReclaimList(Retired* list, const std::vector<const void*>& hazards) {
+        size_t reclaimed = 0;
+        while (list) {
+            Retired* retired = std::exchange(list, list->next);
+            if (std::binary_search(hazards.begin(), hazards.end(), retired->key)) {
+                Push(retired);
+                continue;
+            }
+            retired->reclaim(retired->object);
+            delete retired;
+            ++reclaimed;
+        }
+        retired_count_.fetch_sub(reclaimed, std::memory_order_relaxed);
+    }
+
+    std::atomic<Record*> records_ = nullptr;
+    std::atomic<size_t> record_count_ = 0;
+    std::atomic<Retired*> retired_ = nullptr;
+    std::atomic<size_t> retired_count_ = 0;
+
+    friend class HazardPointer;
+};
+
+// Owns one hazard slot of a domain. Keep it for a whole read loop, acquiring slots is not free.
+class HazardPointer {
+public:
+    explicit HazardPointer(HazardDomain& domain = HazardDomain::Default())
+        : domain_(domain), record_(domain.AcquireRecord()) {
+    }
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+
+    ~HazardPointer() {
+        domain_.ReleaseRecord(record_);
+    }
+
+    // Loads `source` and protects the result: it is not reclaimed until `Reset()` or the next `Protect()`.
+    template <typename T>
+    T* Protect(const std::atomic<T*>& source) {
+        T* pointer = source.load(std::memory_order_relaxed);
+        while (true) {
+            record_->pointer.store(pointer, std::memory_order_seq_cst);
+            T* reloaded = source.load(std::memory_order_seq_cst);
+            if (reloaded == pointer) {
+                return pointer;
+            }
+            pointer = reloaded;
+        }
+    }
+    void Reset() {
+        record_->pointer.store(nullptr, std::memory_order_release);
+    }
+
+private:
+    HazardDomain& domain_;
+    HazardDomain::Record* record_;
+};
+
+// `SharedPtr` release policy: the control block and the object wait in the default domain.
+struct HazardRelease {
+    static bool Release(const void* object, void* block, void (*finish)(void*)) {
+        HazardDomain::Default().Retire(object, block, finish);
+        return false;
+    }
+};
+
+// `RefCounted` deleter: the object waits in the default domain, then `Deleter` destroys it.
+template <typename Deleter = DefaultDelete>
+struct HazardDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        HazardDomain::Default().Retire(object, [](void* retired) { Deleter::Destroy(static_cast<T*>(retired)); });
+    }
+};
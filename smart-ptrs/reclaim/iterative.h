@@ -0,0 +1,171 @@
+#pragma once
+
+#include "../intrusive/intrusive.h"
+#include "../unique/unique.h"
+
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Iterative destruction of long ownership chains. Normally the last reference to the head of a linked list
+// destroys it recursively, a few stack frames per node, and a million nodes overflow the stack.
+// Here a release that happens while another one is running on the same thread is queued instead,
+// and the outermost release destroys the queued objects in a loop.
+//
+// `Budget` is how many objects a single release may destroy. The rest stays in the queue of the thread
+// until its next release or `DrainReleaseQueue()`, so a big teardown doesn't stall the thread all at once.
+// Threads drain their queues completely when they exit.
+//
+// All three families can release through the queue:
+//  * `SharedPtr`: pointee derives from `ReleasedWith<IterativeRelease<Budget>>`;
+//  * `IntrusivePtr`: `RefCounted<Derived, Counter, IterativeDelete<Deleter, Budget>>`;
+//  * `UniquePtr`: `UniquePtr<T, IterativeDeleter<T, Deleter, Budget>>`.
+// Every link of a structure has to release through it: a single recursive one brings the recursion back.
+inline constexpr size_t kUnlimitedReleases = SIZE_MAX;
+
+class ReleaseQueue {
+public:
+    ReleaseQueue(const ReleaseQueue&) = delete;
+    ReleaseQueue& operator=(const ReleaseQueue&) = delete;
+
+    // `destroy(object)` right away, or later if a release is already running on this thread.
+    // Counts towards the budget itself.
+    static void Release(void* object, void (*destroy)(void*), size_t budget) {
+        ReleaseQueue* queue = Current();
+        if (!queue) {
+            destroy(object);  // Thread is exiting and its queue is already gone
+            return;
+        }
+        if (queue->running_) {
+            queue->pending_.push_back({object, destroy});
+            return;
+        }
+        queue->running_ = true;
+        destroy(object);
+        queue->Run(budget - 1);
+        queue->running_ = false;
+    }
+
+    static void Drain(size_t budget) {
+        ReleaseQueue* queue = Current();
+        if (queue && !queue->running_) {
+            queue->running_ = true;
+            queue->Run(budget);
+            queue->running_ = false;
+        }
+    }
+
+    static size_t Pending() {
+        ReleaseQueue* queue = Current();
+        return queue ? queue->pending_.size() : 0;
+    }
+
+private:
+    struct Item {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    enum QueueState : uint8_t {
+        kUnset,
+        kAlive,
+        kDead,
+    };
+
+    ReleaseQueue() {
+        current_queue = this;
+        queue_state = kAlive;
+    }
+    // Objects destroyed here may release more, they are still queued
+    ~ReleaseQueue() {
+        running_ = true;
+        Run(kUnlimitedReleases);
+        queue_state = kDead;
+        current_queue = nullptr;
+    }
+
+    // Last queued first: a teardown goes depth-first, like the recursion would
+    void Run(size_t budget) {
+        for (; budget > 0 && !pending_.empty(); --budget) {
+            Item item = pending_.back();
+            pending_.pop_back();
+            item.destroy(item.object);
+        }
+    }
+
+    static ReleaseQueue* Current() {
+        if (queue_state == kAlive) [[likely]] {
+            return current_queue;
+        }
+        if (queue_state == kDead) {
+            return nullptr;
+        }
+        thread_local ReleaseQueue queue;
+        return current_queue;
+    }
+
+    static inline thread_local QueueState queue_state = kUnset;
+    static inline thread_local ReleaseQueue* current_queue = nullptr;
+
+    bool running_ = false;
+    std::vector<Item> pending_;
+};
+
+// Destroys up to `budget` objects left over by budgeted releases of the current thread.
+// Call it at points where a pause is fine, e.g. between requests.
+inline void DrainReleaseQueue(size_t budget = kUnlimitedReleases) {
+    ReleaseQueue::Drain(budget);
+}
+
+// Objects waiting in the queue of the current thread
+inline size_t PendingReleases() {
+    return ReleaseQueue::Pending();
+}
+
+// `SharedPtr` release policy: the object and the control block go through the queue.
+template <size_t Budget = kUnlimitedReleases>
+struct IterativeRelease {
+    static_assert(Budget > 0, "Budget includes the released object itself");
+
+    static bool Release([[maybe_unused]] const void* object, void* block, void (*finish)(void*)) {
+        ReleaseQueue::Release(block, finish, Budget);
+        return false;
+    }
+};
+
+// `RefCounted` deleter: the object goes through the queue, then `Deleter` destroys it.
+template <typename Deleter = DefaultDelete, size_t Budget = kUnlimitedReleases>
+struct IterativeDelete {
+    static_assert(Budget > 0, "Budget includes the released object itself");
+
+    template <typename T>
+    static void Destroy(T* object) {
+        ReleaseQueue::Release(
+            object, [](void* released) { Deleter::Destroy(static_cast<T*>(released)); }, Budget);
+    }
+};
+
+// `UniquePtr` deleter: the object goes through the queue, then `Deleter` destroys it.
+// `Deleter` is default-constructed for that, so it can't have state.
+template <typename T, typename Deleter = MyDefaultDelete<T>, size_t Budget = kUnlimitedReleases>
+struct IterativeDeleter {
+    static_assert(Budget > 0, "Budget includes the released object itself");
+    static_assert(std::is_empty_v<Deleter>, "Deleter is recreated for the queued call");
+
+    using Pointer = std::remove_extent_t<T>*;
+
+    IterativeDeleter() = default;
+
+    template <typename U, typename UDeleter>
+    IterativeDeleter([[maybe_unused]] const IterativeDeleter<U, UDeleter, Budget>& other) noexcept {
+    }
+
+    void operator()(Pointer ptr) const {
+        if (ptr) {
+            ReleaseQueue::Release(
+                const_cast<void*>(static_cast<const void*>(ptr)),
+                [](void* released) { Deleter()(static_cast<Pointer>(released)); }, Budget);
+        }
+    }
+};
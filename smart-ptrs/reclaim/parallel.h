@@ -0,0 +1,199 @@
+#pragma once
+
+#include "../intrusive/intrusive.h"
+#include "../shared/shared.h"
+
+#include <algorithm>  // std::max
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>  // size_t
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>  // std::exchange
+#include <vector>
+
+// Parallel teardown of big object graphs, e.g. of a whole index at shutdown. `ParallelRelease(root, executor)`
+// drops `root` and destroys what it owns on several threads; `root` is an `IntrusivePtr<T>` or a `SharedPtr<T>`.
+//
+// `T` lists its owning pointers to other nodes:
+//     template <typename Visitor>
+//     void ForEachChild(Visitor&& visit) {
+//         visit(left);
+//         visit(right);
+//     }
+// A child with a single reference belongs to its parent alone: it is detached and torn down the same way,
+// maybe by another thread. A child with more references is put aside and dropped by the caller once
+// the threads are done; if it has become unique by then, the next round tears it down in parallel too.
+// Counters are never changed concurrently, so non-atomic ones (`SimpleCounter`, default `SharedPtr`) are fine.
+//
+// Nobody else may use the graph meanwhile (no `WeakPtr::Lock()` either). Pointers of other types are destroyed
+// with their parent as usual, so they shouldn't be shared between nodes unless their counters are atomic.
+// With `SMART_PTRS_BIASED_REFCOUNT` the nodes are still walked in parallel, but those created by the caller
+// are freed when it merges them in the end.
+//
+// `executor(task)` has to run a `std::function<void()>` on another thread, e.g. post it to a thread pool;
+// `ReleaseWorkers` is a minimal one. The calling thread takes part in the teardown as well.
+template <typename Ptr, typename Executor>
+class ParallelTeardown {
+public:
+    explicit ParallelTeardown(Executor& executor) : executor_(executor) {
+    }
+    ParallelTeardown(const ParallelTeardown&) = delete;
+    ParallelTeardown& operator=(const ParallelTeardown&) = delete;
+
+    // Destroys `roots` and everything they own alone. Returns the shared children that were put aside.
+    std::vector<Ptr> Round(std::deque<Ptr> roots) {
+        {
+            std::lock_guard lock(mutex_);
+            running_ = 1;
+        }
+        Work(std::move(roots));
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return running_ == 0; });
+        return std::exchange(shared_, {});
+    }
+
+private:
+    void Work(std::deque<Ptr> stack) {
+        std::vector<Ptr> shared;
+        while (!stack.empty()) {
+            // Hand off the oldest entry, the biggest subtree, when nothing is waiting for a thread
+            if (stack.size() > 1 && queued_.load(std::memory_order_relaxed) == 0) {
+                Spawn(std::move(stack.front()));
+                stack.pop_front();
+            }
+            Ptr node = std::move(stack.back());
+            stack.pop_back();
+            node->ForEachChild([&](Ptr& child) {
+                if (!child) {
+                    return;
+                }
+                if (child.UseCount() == 1) {
+                    stack.push_back(std::move(child));
+                } else {
+                    shared.push_back(std::move(child));
+                }
+            });
+            node.Reset();  // The children are detached, only the node itself is destroyed
+        }
+
+        std::lock_guard lock(mutex_);
+        shared_.insert(shared_.end(), std::make_move_iterator(shared.begin()), std::make_move_iterator(shared.end()));
+        if (--running_ == 0) {
+            done_.notify_all();  // Under the lock: the caller may destroy us as soon as it sees zero
+        }
+    }
+
+    void Spawn(Ptr root) {
+        {
+            std::lock_guard lock(mutex_);
+            ++running_;
+        }
+        queued_.fetch_add(1, std::memory_order_relaxed);
+        // `std::function` is copyable and a copy of `root` would spoil the counts, so it goes by address
+        auto task_root = new Ptr(std::move(root));
+        executor_([this, task_root] {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            std::deque<Ptr> stack;
+            stack.push_back(std::move(*task_root));
+            delete task_root;
+            Work(std::move(stack));
+        });
+    }
+
+    Executor& executor_;
+    std::atomic<size_t> queued_ = 0;  // Spawned, not started yet
+
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t running_ = 0;      // Guarded by `mutex_`
+    std::vector<Ptr> shared_;  // Guarded by `mutex_`
+};
+
+template <typename Ptr, typename Executor>
+void ParallelRelease(Ptr root, Executor&& executor) {
+    ParallelTeardown<Ptr, std::remove_reference_t<Executor>> teardown(executor);
+    std::deque<Ptr> roots;
+    if (root.UseCount() == 1) {
+        roots.push_back(std::move(root));
+    }
+    root.Reset();
+    while (!roots.empty()) {
+        std::vector<Ptr> shared = teardown.Round(std::move(roots));
+        roots.clear();
+        // One by one: the last of several references to a node finds it unique
+        for (auto& child : shared) {
+            if (child.UseCount() == 1) {
+                roots.push_back(std::move(child));
+            } else {
+                child.Reset();
+            }
+        }
+    }
+#ifdef SMART_PTRS_BIASED_REFCOUNT
+    MergeBiasedRefCounts();
+#endif
+}
+
+// Minimal executor for `ParallelRelease`: a fixed set of threads taking tasks from a common queue.
+class ReleaseWorkers {
+public:
+    explicit ReleaseWorkers(size_t threads = std::max(std::thread::hardware_concurrency(), 1u)) {
+        threads_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            threads_.emplace_back([this] { Run(); });
+        }
+    }
+    ReleaseWorkers(const ReleaseWorkers&) = delete;
+    ReleaseWorkers& operator=(const ReleaseWorkers&) = delete;
+
+    // Queued tasks are still run
+    ~ReleaseWorkers() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void operator()(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    size_t Threads() const {
+        return threads_.size();
+    }
+
+private:
+    void Run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::function<void()>> tasks_;  // Guarded by `mutex_`
+    bool stopping_ = false;                    // Guarded by `mutex_`
+    std::vector<std::thread> threads_;
+};
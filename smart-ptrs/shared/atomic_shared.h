@@ -0,0 +1,157 @@
+#pragma once
+
+#include "shared.h"
+#include "sw_fwd.h"  // Forward declaration
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/atomic2
+// Slot holding a `SharedPtr` that can be loaded and replaced concurrently. Loads are lock-free
+// and never wait for writers.
+//
+// Split reference counting: the slot word keeps a pointer to an immutable node with the value
+// (low 48 bits, fine for x86-64 and AArch64 user space) and the number of readers that are copying it
+// right now (high 16 bits). A reader announces itself with a single `fetch_add` on the word, copies
+// the value and takes the announcement back. A writer that swaps the node out moves the announcements
+// into the node counter, so the node lives until the last of those readers is done.
+template <typename T>
+class AtomicSharedPtr {
+    static_assert(!std::is_same_v<SharedRefCounter, SimpleSharedCounter>,
+                  "AtomicSharedPtr needs thread-safe counters: define SMART_PTRS_ATOMIC_REFCOUNT "
+                  "or SMART_PTRS_BIASED_REFCOUNT");
+    static_assert(sizeof(uintptr_t) == 8, "Slot word packing assumes 64-bit pointers");
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    AtomicSharedPtr() noexcept : slot_(0) {
+    }
+    AtomicSharedPtr(SharedPtr<T> desired) : slot_(ToWord(MakeNode(std::move(desired)))) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~AtomicSharedPtr() {
+        Retire(slot_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Operations
+
+    SharedPtr<T> Load() const {
+        // Readers of an empty slot have nothing to protect, the count of the empty word is meaningless.
+        if (slot_.load(std::memory_order_relaxed) == 0) {
+            return SharedPtr<T>();
+        }
+        Node* node = ToNode(slot_.fetch_add(kReaderOne, std::memory_order_acquire));
+        if (!node) {
+            return SharedPtr<T>();
+        }
+        SharedPtr<T> result = node->value;
+        LeaveNode(node);
+        return result;
+    }
+    void Store(SharedPtr<T> desired) {
+        Retire(slot_.exchange(ToWord(MakeNode(std::move(desired))), std::memory_order_acq_rel));
+    }
+    SharedPtr<T> Exchange(SharedPtr<T> desired) {
+        uintptr_t old = slot_.exchange(ToWord(MakeNode(std::move(desired))), std::memory_order_acq_rel);
+        Node* node = ToNode(old);
+        SharedPtr<T> result = node ? node->value : SharedPtr<T>();
+        Retire(old);
+        return result;
+    }
+
+    // Replaces the value with `desired` if it is the same pointer (and owner) as `expected`,
+    // otherwise loads the current value into `expected`.
+    bool CompareExchange(SharedPtr<T>& expected, SharedPtr<T> desired) {
+        Node* desired_node = MakeNode(std::move(desired));
+        while (true) {
+            uintptr_t word = slot_.fetch_add(kReaderOne, std::memory_order_acquire);
+            Node* node = ToNode(word);
+            if (!Holds(node, expected)) {
+                expected = node ? node->value : SharedPtr<T>();
+                LeaveNode(node);
+                delete desired_node;
+                return false;
+            }
+            word = slot_.load(std::memory_order_relaxed);
+            while (ToNode(word) == node) {
+                if (slot_.compare_exchange_weak(word, ToWord(desired_node), std::memory_order_acq_rel,
+                                                std::memory_order_relaxed)) {
+                    Retire(word);  // Our announcement goes to the node counter too
+                    Unref(node);
+                    return true;
+                }
+            }
+            // Somebody else has replaced the node meanwhile
+            Unref(node);
+        }
+    }
+
+private:
+    struct Node {
+        SharedPtr<T> value;
+        // Announcements moved here when the node is swapped out, minus readers that have left since.
+        std::atomic<int64_t> refs = 0;
+    };
+
+    static constexpr uintptr_t kPointerMask = (uintptr_t{1} << 48) - 1;
+    static constexpr uintptr_t kReaderOne = uintptr_t{1} << 48;
+
+    static Node* MakeNode(SharedPtr<T> value) {
+        return value.block_ ? new Node{std::move(value)} : nullptr;
+    }
+    static Node* ToNode(uintptr_t word) {
+        return reinterpret_cast<Node*>(word & kPointerMask);
+    }
+    static uintptr_t ToWord(Node* node) {
+        return reinterpret_cast<uintptr_t>(node);
+    }
+    static bool Holds(Node* node, const SharedPtr<T>& value) {
+        if (!node) {
+            return !value.block_;
+        }
+        return node->value.block_ == value.block_ && node->value.observer_ == value.observer_;
+    }
+
+    static void Unref(Node* node) {
+        if (node && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+    // Node is swapped out: readers still announced in the old word will `Unref` it.
+    static void Retire(uintptr_t word) {
+        Node* node = ToNode(word);
+        if (!node) {
+            return;
+        }
+        int64_t readers = word >> 48;
+        if (node->refs.fetch_add(readers, std::memory_order_acq_rel) + readers == 0) {
+            delete node;
+        }
+    }
+    // Takes our announcement back from the slot, or from the node if it has been swapped out.
+    void LeaveNode(Node* node) const {
+        if (!node) {
+            return;
+        }
+        uintptr_t word = slot_.load(std::memory_order_relaxed);
+        while (ToNode(word) == node) {
+            if (slot_.compare_exchange_weak(word, word - kReaderOne, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        Unref(node);
+    }
+
+    mutable std::atomic<uintptr_t> slot_;
+};
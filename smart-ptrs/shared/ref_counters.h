@@ -0,0 +1,517 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <cstdlib>  // std::abort
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Reference counters for `SharedPtr`/`WeakPtr` control blocks.
+// Both counts are packed into one word: strong in the low half, weak in the high one.
+// All strong references together hold a single weak one, so a strong operation touches only the strong count,
+// and the block stays alive while the object is being destroyed.
+// `TryIncRef()` makes a strong reference out of a weak one in a single step: "increment if not zero".
+//
+// `SimpleSharedCounter` is the default: plain integers, single-threaded use only.
+// Define `SMART_PTRS_ATOMIC_REFCOUNT` (for the whole program!) to switch all control blocks
+// to `AtomicSharedCounter`, which allows to share pointers between threads.
+// `SMART_PTRS_BIASED_REFCOUNT` selects `BiasedSharedCounter`: also thread-safe, but cheap for the creating thread.
+//
+// `MakeImmortal()` adds a flag to the strong count so that it never drops to zero: the object is never destroyed.
+// With `SMART_PTRS_IMMORTAL_OBJECTS` copies and releases skip the counter of such objects altogether, at the cost
+// of a check in every counter operation. Flag objects before they are shared with other threads.
+// `RefCount()` of an immortal object is just big.
+//
+// `SMART_PTRS_NARROW_REFCOUNT` makes plain and atomic counts 16-bit, for programs with lots of small objects
+// and few references to each: 4 bytes per block instead of 8, e.g. the block of `MakeShared<int>` shrinks from
+// 24 bytes to 16. A strong count that grows up to the immortal flag saturates there, so narrow counters always
+// check for it; a weak count saturates at its maximum and the block is leaked. Define
+// `SMART_PTRS_TRAP_REFCOUNT_OVERFLOW` to abort instead. `BiasedSharedCounter` keeps its width.
+
+inline void OnSharedRefCountOverflow() {
+#ifdef SMART_PTRS_TRAP_REFCOUNT_OVERFLOW
+    std::abort();
+#endif
+}
+
+template <typename Int>
+class BasicSimpleSharedCounter {
+public:
+    void IncRef() {
+        if (IsImmortal()) {
+            return;
+        }
+        ++ref_counter_;
+        if (kNarrow && ref_counter_ == kImmortal) {
+            OnSharedRefCountOverflow();
+        }
+    }
+    bool TryIncRef() {
+        if (ref_counter_ == 0) {
+            return false;
+        }
+        IncRef();
+        return true;
+    }
+    // Returns the number of strong references left. When it is zero, the object has to be destroyed
+    // and then the weak reference of strong ones released with `DecWeakRef()`.
+    size_t DecRef() {
+        if (IsImmortal()) {
+            return ref_counter_;
+        }
+        return --ref_counter_;
+    }
+
+    void IncWeakRef() {
+        if constexpr (kNarrow) {
+            if (weak_ref_counter_ == kWeakSaturated) {
+                return;
+            }
+            if (++weak_ref_counter_ == kWeakSaturated) {
+                OnSharedRefCountOverflow();
+            }
+        } else {
+            ++weak_ref_counter_;
+        }
+    }
+    size_t DecWeakRef() {
+        if (kNarrow && weak_ref_counter_ == kWeakSaturated) {
+            return weak_ref_counter_;
+        }
+        return --weak_ref_counter_;
+    }
+
+    size_t RefCount() const {
+        return ref_counter_;
+    }
+    // Plain decrements are as cheap as the check, so there is no shortcut.
+    bool ReleaseIfUnique() {
+        return false;
+    }
+
+    void MakeImmortal() {
+        ref_counter_ |= kImmortal;
+    }
+
+private:
+    static constexpr bool kNarrow = sizeof(Int) < sizeof(uint32_t);
+    static constexpr Int kImmortal = Int{1} << (std::numeric_limits<Int>::digits - 1);
+    static constexpr Int kWeakSaturated = std::numeric_limits<Int>::max();
+
+    bool IsImmortal() const {
+#ifndef SMART_PTRS_IMMORTAL_OBJECTS
+        if (!kNarrow) {
+            return false;
+        }
+#endif
+        return ref_counter_ & kImmortal;
+    }
+
+    Int ref_counter_ = 0;
+    Int weak_ref_counter_ = 1;
+};
+
+// Strong count is sticky at zero, see "Concurrent Deferred Reference Counting with Constant-Time Overhead"
+// by Anderson, Blelloch and Wei: the thread that brings it to zero has to mark it with `kDead` before destroying
+// the object. Until then an increment may revive the object, so `TryIncRef()` is a single wait-free `fetch_add`.
+template <typename Word>
+class BasicAtomicSharedCounter {
+public:
+    // New references are always made from existing ones, so nothing has to be ordered here.
+    void IncRef() {
+        if (IsImmortal()) {
+            return;
+        }
+        Word previous = counters_.fetch_add(kStrongOne, std::memory_order_relaxed);
+        if (kNarrow && Strong(previous) + 1 == kImmortal) {
+            OnSharedRefCountOverflow();
+        }
+    }
+    // Acquire the writes of whoever has dropped the previous references.
+    // Expired pointers are usually locked over and over again, and zero is final: they fail without a write.
+    bool TryIncRef() {
+        if (counters_.load(std::memory_order_relaxed) & kDead) {
+            return false;
+        }
+        if (IsImmortal()) {
+            return true;
+        }
+        Word previous = counters_.fetch_add(kStrongOne, std::memory_order_acquire);
+        if (!(previous & kDead)) {
+            if (kNarrow && Strong(previous) + 1 == kImmortal) {
+                OnSharedRefCountOverflow();
+            }
+            return true;
+        }
+        counters_.fetch_sub(kStrongOne, std::memory_order_relaxed);  // Dead count must not grow into the weak one
+        return false;
+    }
+    // Release our writes to the object, acquire everyone else's before it is destroyed.
+    // Returns zero only to the thread that has to destroy the object.
+    size_t DecRef() {
+        if (IsImmortal()) {
+            return RefCount();
+        }
+        Word counters = counters_.fetch_sub(kStrongOne, std::memory_order_acq_rel) - kStrongOne;
+        // Saturated by other threads meanwhile: the count mustn't go down anymore
+        if (kNarrow && Strong(counters) + 1 >= kImmortal) {
+            counters_.fetch_add(kStrongOne, std::memory_order_relaxed);
+            return Strong(counters) + 1;
+        }
+        while (Strong(counters) == 0 && !(counters & kDead)) {
+            if (counters_.compare_exchange_weak(counters, counters | kDead, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed)) {
+                return 0;
+            }
+        }
+        // Revived by `TryIncRef()`: the object is destroyed by whoever drops the new reference.
+        return counters & kDead ? 1 : Strong(counters);
+    }
+
+    // Narrow weak counts are CAS loops: a saturated count stays as it is, and can't overflow into other bits.
+    void IncWeakRef() {
+        if constexpr (kNarrow) {
+            Word counters = counters_.load(std::memory_order_relaxed);
+            do {
+                if (Weak(counters) == kWeakSaturated) {
+                    return;
+                }
+            } while (!counters_.compare_exchange_weak(counters, counters + kWeakOne, std::memory_order_relaxed));
+            if (Weak(counters) + 1 == kWeakSaturated) {
+                OnSharedRefCountOverflow();
+            }
+        } else {
+            counters_.fetch_add(kWeakOne, std::memory_order_relaxed);
+        }
+    }
+    size_t DecWeakRef() {
+        if constexpr (kNarrow) {
+            Word counters = counters_.load(std::memory_order_relaxed);
+            do {
+                if (Weak(counters) == kWeakSaturated) {
+                    return kWeakSaturated;
+                }
+            } while (!counters_.compare_exchange_weak(counters, counters - kWeakOne, std::memory_order_acq_rel,
+                                                      std::memory_order_relaxed));
+            return Weak(counters) - 1;
+        } else {
+            return Weak(counters_.fetch_sub(kWeakOne, std::memory_order_acq_rel)) - 1;
+        }
+    }
+
+    size_t RefCount() const {
+        Word counters = counters_.load(std::memory_order_relaxed);
+        return counters & kDead ? 0 : Strong(counters);
+    }
+    // The caller holds the only strong reference and there are no weak ones, so nobody else can reach
+    // the block anymore: it may be destroyed without a read-modify-write. The count is still marked dead with
+    // a plain store, the object may look at it while being destroyed (`EnableSharedFromThisInPlace`).
+    bool ReleaseIfUnique() {
+        if (counters_.load(std::memory_order_acquire) != kStrongOne + kWeakOne) {
+            return false;
+        }
+        counters_.store(kDead + kWeakOne, std::memory_order_relaxed);
+        return true;
+    }
+
+    void MakeImmortal() {
+        counters_.fetch_or(kImmortal, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr bool kNarrow = sizeof(Word) < sizeof(uint64_t);
+    static constexpr int kHalf = std::numeric_limits<Word>::digits / 2;
+    static constexpr Word kStrongOne = 1;
+    static constexpr Word kImmortal = Word{1} << (kHalf - 2);  // Part of the strong count, so it is never zero
+    static constexpr Word kDead = Word{1} << (kHalf - 1);
+    static constexpr Word kWeakOne = Word{1} << kHalf;
+    static constexpr size_t kWeakSaturated = std::numeric_limits<Word>::max() >> kHalf;
+
+    static size_t Strong(Word counters) {
+        return counters & (kDead - 1);
+    }
+    static size_t Weak(Word counters) {
+        return counters >> kHalf;
+    }
+
+    // No load at all in the wide one unless `SMART_PTRS_IMMORTAL_OBJECTS` is defined
+    bool IsImmortal() const {
+#ifndef SMART_PTRS_IMMORTAL_OBJECTS
+        if (!kNarrow) {
+            return false;
+        }
+#endif
+        return counters_.load(std::memory_order_relaxed) & kImmortal;
+    }
+
+    std::atomic<Word> counters_ = kWeakOne;
+};
+
+#ifdef SMART_PTRS_NARROW_REFCOUNT
+using SimpleSharedCounter = BasicSimpleSharedCounter<uint16_t>;
+using AtomicSharedCounter = BasicAtomicSharedCounter<uint32_t>;
+#else
+using SimpleSharedCounter = BasicSimpleSharedCounter<uint32_t>;
+using AtomicSharedCounter = BasicAtomicSharedCounter<uint64_t>;
+#endif
+
+// Merge requests queued to the owner thread of a biased counter.
+// Thread is registered on the first use of a biased counter, its queue is drained
+// by `MergeBiasedRefCounts()` and when the thread exits.
+class BiasedOwnerQueue {
+public:
+    struct Request {
+        void* block;
+        void (*merge)(void* block);
+    };
+
+    // Unique for the whole run, never reused.
+    static uintptr_t CurrentToken() {
+        thread_local uintptr_t token = 0;
+        if (token == 0) [[unlikely]] {
+            token = Current().token_;
+        }
+        return token;
+    }
+
+    static void Push(uintptr_t owner, Request request) {
+        {
+            std::lock_guard guard(Mutex());
+            auto it = Queues().find(owner);
+            if (it != Queues().end()) {
+                it->second->requests_.push_back(request);
+                return;
+            }
+        }
+        // Owner has exited, its local counter won't change anymore: merge right here.
+        request.merge(request.block);
+    }
+
+    static void DrainCurrent() {
+        Current().Drain();
+    }
+
+    BiasedOwnerQueue(const BiasedOwnerQueue&) = delete;
+    BiasedOwnerQueue& operator=(const BiasedOwnerQueue&) = delete;
+
+private:
+    BiasedOwnerQueue() : token_(NextToken().fetch_add(1, std::memory_order_relaxed)) {
+        std::lock_guard guard(Mutex());
+        Queues().emplace(token_, this);
+    }
+    ~BiasedOwnerQueue() {
+        {
+            std::lock_guard guard(Mutex());
+            Queues().erase(token_);
+        }
+        Drain();
+    }
+
+    void Drain() {
+        std::vector<Request> requests;
+        {
+            std::lock_guard guard(Mutex());
+            requests.swap(requests_);
+        }
+        for (auto& request : requests) {
+            request.merge(request.block);
+        }
+    }
+
+    static BiasedOwnerQueue& Current() {
+        thread_local BiasedOwnerQueue queue;
+        return queue;
+    }
+
+    // Function-local statics: control blocks may be created during static initialization.
+    static std::mutex& Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::unordered_map<uintptr_t, BiasedOwnerQueue*>& Queues() {
+        static std::unordered_map<uintptr_t, BiasedOwnerQueue*> queues;
+        return queues;
+    }
+    static std::atomic<uintptr_t>& NextToken() {
+        static std::atomic<uintptr_t> next_token = 1;
+        return next_token;
+    }
+
+    uintptr_t token_;
+    std::vector<Request> requests_;  // Guarded by `Mutex()`
+};
+
+// Executes merges queued to the current thread. Call it from time to time on threads that
+// create objects which die elsewhere, otherwise they are only freed when the creating thread exits.
+inline void MergeBiasedRefCounts() {
+    BiasedOwnerQueue::DrainCurrent();
+}
+
+// Biased reference counting, see "Biased Reference Counting" by Choi, Shull and Torrellas.
+// The thread that created the block (the owner) counts its references in `local_` without atomic RMWs,
+// other threads use the atomic `shared_`. They are merged when the owner drops its last reference.
+// If other threads release more references than they have taken (the owner has handed some off),
+// the block is queued to the owner, which merges it later; the queue holds the dropped reference meanwhile.
+//
+// `RefCount()` is exact only on the owner thread or after the merge.
+class BiasedSharedCounter {
+public:
+    // `DecRef()` result: the block has to be queued to `Owner()` with `BiasedOwnerQueue::Push`.
+    static constexpr size_t kMergeRequested = SIZE_MAX;
+
+    BiasedSharedCounter() : owner_(BiasedOwnerQueue::CurrentToken()) {
+    }
+
+    // The owner only does relaxed loads and stores, no read-modify-writes.
+    void IncRef() {
+        if (IsOwner()) {
+            local_.store(local_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else if (!IsImmortal()) {
+            shared_.fetch_add(kSharedOne, std::memory_order_relaxed);
+        }
+    }
+    // The owner's references keep the object alive. Otherwise it is alive until merged with zero count:
+    // a merge has to see our increment, as both go through `shared_` with a CAS.
+    bool TryIncRef() {
+        if (IsOwner() && local_.load(std::memory_order_relaxed) > 0) {
+            local_.store(local_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+        if (IsImmortal()) {
+            return true;
+        }
+        int64_t shared = shared_.load(std::memory_order_relaxed);
+        do {
+            if ((shared & kMerged) && Count(shared) == 0) {
+                return false;
+            }
+        } while (!shared_.compare_exchange_weak(shared, shared + kSharedOne, std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return true;
+    }
+    size_t DecRef() {
+        if (IsImmortal()) {
+            return RefCount();
+        }
+        if (!IsOwner()) {
+            return DecRefShared();
+        }
+        auto local = local_.load(std::memory_order_relaxed) - 1;
+        local_.store(local, std::memory_order_relaxed);
+        return local == 0 ? MergeZeroLocal() : local;
+    }
+
+    void IncWeakRef() {
+        weak_ref_counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+    size_t DecWeakRef() {
+        return weak_ref_counter_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+
+    size_t RefCount() const {
+        int64_t refs = local_.load(std::memory_order_relaxed) + Count(shared_.load(std::memory_order_relaxed));
+        return refs > 0 ? refs : 0;
+    }
+    bool ReleaseIfUnique() {
+        return false;
+    }
+
+    uintptr_t Owner() const {
+        return owner_.load(std::memory_order_relaxed);
+    }
+
+    // Merges the counts for good: no thread owns the block anymore.
+    void MakeImmortal() {
+        int64_t refs = local_.exchange(0, std::memory_order_relaxed) + kImmortalRefs;
+        shared_.fetch_add(refs * kSharedOne, std::memory_order_relaxed);
+        owner_.store(kImmortalOwner, std::memory_order_relaxed);
+    }
+
+    // Executes a queued merge on the owner thread (or anywhere, once the owner has exited)
+    // and drops the reference held by the queue. Returns the number of strong references left.
+    size_t MergeQueued() {
+        int64_t local = local_.load(std::memory_order_relaxed);
+        int64_t shared = shared_.load(std::memory_order_relaxed);
+        int64_t refs;
+        do {
+            // Once merged (the owner could have done it after the request was queued), local counter is empty.
+            refs = (shared & kMerged ? 0 : local) + Count(shared) - 1;
+        } while (!shared_.compare_exchange_weak(shared, refs * kSharedOne | kMerged, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed));
+        local_.store(0, std::memory_order_relaxed);
+        owner_.store(0, std::memory_order_relaxed);
+        return refs;
+    }
+
+private:
+    static constexpr int64_t kQueued = 1;
+    static constexpr int64_t kMerged = 2;
+    static constexpr int64_t kFlags = kQueued | kMerged;
+    static constexpr int64_t kSharedOne = 4;
+    static constexpr uintptr_t kImmortalOwner = UINTPTR_MAX;  // Tokens are counted from 1, never reach it
+    static constexpr int64_t kImmortalRefs = int64_t{1} << 30;
+
+    static int64_t Count(int64_t shared) {
+        return shared >> 2;
+    }
+
+    bool IsOwner() const {
+        return owner_.load(std::memory_order_relaxed) == BiasedOwnerQueue::CurrentToken();
+    }
+    bool IsImmortal() const {
+#ifdef SMART_PTRS_IMMORTAL_OBJECTS
+        return owner_.load(std::memory_order_relaxed) == kImmortalOwner;
+#else
+        return false;
+#endif
+    }
+
+    size_t DecRefShared() {
+        int64_t shared = shared_.load(std::memory_order_relaxed);
+        int64_t desired;
+        do {
+            // Count would go negative: the rest is in the owner's local counter, hand our reference to the queue.
+            desired = shared == 0 ? kQueued : shared - kSharedOne;
+        } while (!shared_.compare_exchange_weak(shared, desired, std::memory_order_acq_rel, std::memory_order_relaxed));
+        if (shared == 0) {
+            return kMergeRequested;
+        }
+        if (desired & kMerged) {
+            return Count(desired);
+        }
+        return Count(desired) > 0 ? Count(desired) : 1;  // The owner still has references
+    }
+
+    size_t MergeZeroLocal() {
+        int64_t shared = shared_.load(std::memory_order_acquire);
+        if (shared == 0 && weak_ref_counter_.load(std::memory_order_acquire) == 1) {
+            return 0;  // Nobody else has ever referenced the block, and nobody can: there are no weak references
+        }
+        owner_.store(0, std::memory_order_relaxed);
+        int64_t merged;
+        do {
+            merged = (shared & ~kFlags) | kMerged;
+        } while (!shared_.compare_exchange_weak(shared, merged, std::memory_order_acq_rel, std::memory_order_acquire));
+        return Count(merged);
+    }
+
+    std::atomic<uintptr_t> owner_;
+    std::atomic<uint32_t> local_ = 0;
+    std::atomic<uint32_t> weak_ref_counter_ = 1;
+    std::atomic<int64_t> shared_ = 0;
+};
+
+// `SMART_PTRS_SHARED_COUNTER` replaces the counter of control blocks with another class of the same interface,
+// e.g. an instrumented one (see benchmarks/refcount_ops.cpp). It has to be declared before this header.
+#ifdef SMART_PTRS_SHARED_COUNTER
+using SharedRefCounter = SMART_PTRS_SHARED_COUNTER;
+#elif defined(SMART_PTRS_BIASED_REFCOUNT)
+using SharedRefCounter = BiasedSharedCounter;
+#elif defined(SMART_PTRS_ATOMIC_REFCOUNT)
+using SharedRefCounter = AtomicSharedCounter;
+#else
+using SharedRefCounter = SimpleSharedCounter;
+#endif
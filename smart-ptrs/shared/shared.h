@@ -1,118 +1,464 @@
 #pragma once
 
+#include "ref_counters.h"
 #include "sw_fwd.h"  // Forward declaration
+#include "../stats/stats.h"
+#include "../unique/compressed_pair.h"
+#include "../unique/unique.h"  // MyDefaultDelete
 
+#ifdef SMART_PTRS_SLAB_CONTROL_BLOCKS
+#include "../alloc/slab.h"
+#endif
+
+#include <algorithm>  // std::max
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>  // uintptr_t
+#include <limits>
+#include <memory>  // std::allocator_traits
+#include <memory_resource>
 #include <new>
 #include <type_traits>
+#include <utility>  // std::exchange
+
+// Define `SMART_PTRS_SLAB_CONTROL_BLOCKS` to take control blocks of `SharedPtr(ptr)` and `MakeShared`
+// from the thread-caching `SlabHeap` instead of the global heap.
+#ifdef SMART_PTRS_SLAB_CONTROL_BLOCKS
+template <typename T>
+using DefaultBlockAllocator = SlabAllocator<T>;
+#else
+template <typename T>
+using DefaultBlockAllocator = std::allocator<T>;
+#endif
 
+// Counters live here and are not virtual, so refcount operations are inlined into `SharedPtr`/`WeakPtr`.
+// Only destruction of the object and freeing of the block are type-erased.
 class ControlBlockBase {
 public:
-    virtual void IncrementRefCounter() = 0;
-    virtual void DecrementRefCounter() = 0;
-    virtual void IncrementWeakRefCounter() = 0;
-    virtual void DecrementWeakRefCounter() = 0;
-    virtual size_t GetRefCount() = 0;
-    virtual ~ControlBlockBase() {
+    void IncrementRefCounter() {
+        counter_.IncRef();
+#ifdef SMART_PTRS_STATS
+        stats_->OnIncrement();
+#endif
+    }
+    // Promotes a weak reference, fails once the object is gone
+    bool TryIncrementRefCounter() {
+        if (!counter_.TryIncRef()) {
+            return false;
+        }
+#ifdef SMART_PTRS_STATS
+        stats_->OnIncrement();
+#endif
+        return true;
+    }
+    void DecrementRefCounter() {
+#ifdef SMART_PTRS_STATS
+        stats_->OnDecrement();
+#endif
+        if (counter_.ReleaseIfUnique()) {
+            if (DestroyObject()) {
+                DeallocateBlock();
+            }
+            return;
+        }
+        auto left = counter_.DecRef();
+        if (left == 0) {
+            ReleaseObject();
+        }
+#ifdef SMART_PTRS_BIASED_REFCOUNT
+        else if (left == SharedRefCounter::kMergeRequested) {
+            BiasedOwnerQueue::Push(counter_.Owner(), {this, &MergeQueued});
+        }
+#endif
+    }
+
+    void IncrementWeakRefCounter() {
+        counter_.IncWeakRef();
     }
+    void DecrementWeakRefCounter() {
+        if (counter_.DecWeakRef() == 0) {
+            DeallocateBlock();
+        }
+    }
+
+    size_t GetRefCount() const {
+        return counter_.RefCount();
+    }
+
+    void MakeImmortal() {
+        counter_.MakeImmortal();
+    }
+
+    // Type of the object held in place, null for blocks that point to their object. Checked before a block
+    // is cast to `ControlBlockInPlace`, no RTTI needed.
+    virtual const void* InPlaceTag() const {
+        return nullptr;
+    }
+
+#ifdef SMART_PTRS_SLAB_CONTROL_BLOCKS
+    static void* operator new(size_t size) {
+        if (SlabHeap::Handles(size, alignof(std::max_align_t))) {
+            return SlabHeap::Allocate(size);
+        }
+        return ::operator new(size);
+    }
+    static void operator delete(void* block, size_t size) {
+        if (SlabHeap::Handles(size, alignof(std::max_align_t))) {
+            SlabHeap::Deallocate(block);
+            return;
+        }
+        ::operator delete(block);
+    }
+#endif
+
+protected:
+    // Returns false if the release policy of the object has postponed its destruction.
+    // The policy then takes over the weak reference of strong ones.
+    virtual bool DestroyObject() = 0;
+    virtual void DeallocateBlock() = 0;
+
+    ~ControlBlockBase() = default;
+
+    // Statistics of the block go to the pointee type, see stats/stats.h
+    template <typename Y>
+    void TrackCreate(size_t bytes) {
+        TrackStats<std::remove_cv_t<Y>>::OnCreate(bytes);
+#ifdef SMART_PTRS_STATS
+        stats_ = &PointerStats::Of<std::remove_cv_t<Y>>();
+#endif
+    }
+    template <typename Y>
+    static void TrackDestroy(size_t bytes) {
+        TrackStats<std::remove_cv_t<Y>>::OnDestroy(bytes);
+    }
+
+private:
+    void ReleaseObject() {
+        // Weak reference of all strong ones is released after destruction, so the block is not cleared
+        // "under legs" in ESFT case
+        if (DestroyObject()) {
+            DecrementWeakRefCounter();
+        }
+    }
+
+#ifdef SMART_PTRS_BIASED_REFCOUNT
+    static void MergeQueued(void* block) {
+        auto self = static_cast<ControlBlockBase*>(block);
+        if (self->counter_.MergeQueued() == 0) {
+            self->ReleaseObject();
+        }
+    }
+#endif
+
+    SharedRefCounter counter_;
+#ifdef SMART_PTRS_STATS
+    PointerStats* stats_ = nullptr;
+#endif
 };
 
 class ESFTBase {};
+class ESFTInPlaceBase {};
+
+// Release policy decides when an object is destroyed after its last strong reference is gone.
+// `Release(object, block, finish)` returns true to destroy it right away. Otherwise the policy
+// has to call `finish(block)` later: it destroys the object and releases the weak reference of strong ones.
+struct ImmediateRelease {
+    static bool Release([[maybe_unused]] const void* object, [[maybe_unused]] void* block,
+                        [[maybe_unused]] void (*finish)(void*)) {
+        return true;
+    }
+};
 
+// Derive from it to choose a release policy, like `class Config : public ReleasedWith<HazardRelease>`.
+template <typename Policy>
+class ReleasedWith {
+public:
+    using SharedReleasePolicy = Policy;
+};
+
+template <typename Y>
+struct SharedReleasePolicyOf {
+    using Type = ImmediateRelease;
+};
 template <typename Y>
-class ControlBlockWithPtr : public ControlBlockBase {
+    requires requires { typename Y::SharedReleasePolicy; }
+struct SharedReleasePolicyOf<Y> {
+    using Type = typename Y::SharedReleasePolicy;
+};
+
+template <typename Y>
+class ControlBlockWithPtr final : public ControlBlockBase {
 public:
-    ControlBlockWithPtr(Y* ptr) : ptr_(ptr), ref_counter_(0), weak_ref_counter_(0) {
+    ControlBlockWithPtr(Y* ptr) : ptr_(ptr) {
+        TrackCreate<Y>(sizeof(ControlBlockWithPtr) + TrackedSize<Y>());
     }
 
-    virtual void IncrementRefCounter() override {
-        ++ref_counter_;
-        ++weak_ref_counter_;
-    }
-    virtual void DecrementRefCounter() override {
-        --ref_counter_;
-        --weak_ref_counter_;
-        if (ref_counter_ == 0) {
-            ++weak_ref_counter_;  // This prevents us from clearing memory "under legs" in ESFT case
-            delete ptr_;
-            --weak_ref_counter_;
+private:
+    virtual bool DestroyObject() override {
+        if (!SharedReleasePolicyOf<Y>::Type::Release(ptr_, this, &FinishRelease)) {
+            return false;
         }
-        if (weak_ref_counter_ == 0) {
-            delete this;
+        Destroy();
+        return true;
+    }
+    virtual void DeallocateBlock() override {
+        delete this;
+    }
+
+    static void FinishRelease(void* block) {
+        auto self = static_cast<ControlBlockWithPtr*>(block);
+        self->Destroy();
+        self->DecrementWeakRefCounter();
+    }
+
+    void Destroy() {
+        TrackDestroy<Y>(sizeof(ControlBlockWithPtr) + TrackedSize<Y>());
+        delete ptr_;
+    }
+
+    Y* ptr_;
+};
+
+// Empty deleters and allocators take no space, others are stored inline: no allocation besides the block.
+template <typename Y, typename Deleter, typename Alloc>
+class ControlBlockWithDeleter final : public ControlBlockBase {
+public:
+    using BlockAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockWithDeleter>;
+    using BlockTraits = std::allocator_traits<BlockAllocator>;
+
+    // Like `std::shared_ptr`, `ptr` is deleted if the block can't be allocated.
+    static ControlBlockWithDeleter* Create(Y* ptr, Deleter deleter, const Alloc& alloc) {
+        BlockAllocator allocator(alloc);
+        ControlBlockWithDeleter* block;
+        try {
+            block = BlockTraits::allocate(allocator, 1);
+        } catch (...) {
+            deleter(ptr);
+            throw;
         }
+        return ::new (block) ControlBlockWithDeleter(ptr, std::move(deleter), allocator);
     }
 
-    virtual void IncrementWeakRefCounter() override {
-        ++weak_ref_counter_;
+private:
+    ControlBlockWithDeleter(Y* ptr, Deleter&& deleter, const BlockAllocator& allocator)
+        : ptr_and_deleter_(ptr, std::move(deleter)), allocator_(allocator) {
+        TrackCreate<Y>(sizeof(ControlBlockWithDeleter) + TrackedSize<Y>());
     }
-    virtual void DecrementWeakRefCounter() override {
-        --weak_ref_counter_;
-        if (weak_ref_counter_ == 0) {
-            delete this;
+
+    virtual bool DestroyObject() override {
+        if (!SharedReleasePolicyOf<Y>::Type::Release(ptr_and_deleter_.GetFirst(), this, &FinishRelease)) {
+            return false;
         }
+        Destroy();
+        return true;
+    }
+    virtual void DeallocateBlock() override {
+        BlockAllocator allocator(allocator_);
+        this->~ControlBlockWithDeleter();
+        BlockTraits::deallocate(allocator, this, 1);
     }
 
-    virtual size_t GetRefCount() override {
-        return ref_counter_;
+    static void FinishRelease(void* block) {
+        auto self = static_cast<ControlBlockWithDeleter*>(block);
+        self->Destroy();
+        self->DecrementWeakRefCounter();
     }
 
+    void Destroy() {
+        TrackDestroy<Y>(sizeof(ControlBlockWithDeleter) + TrackedSize<Y>());
+        ptr_and_deleter_.GetSecond()(ptr_and_deleter_.GetFirst());
+    }
+
+    CompressedPair<Y*, Deleter> ptr_and_deleter_;
+    [[no_unique_address]] BlockAllocator allocator_;
+};
+
+// Object lives right in the block. It is at the same offset for any allocator,
+// so `EnableSharedFromThisInPlace` finds the block from `this`.
+template <typename Object>
+class ControlBlockInPlace : public ControlBlockBase {
+public:
+    Object* GetObject() {
+        return reinterpret_cast<Object*>(&buffer_);
+    }
+
+    static ControlBlockInPlace* FromObject(const Object* object) {
+        auto buffer = reinterpret_cast<const std::byte*>(object) - ObjectOffset();
+        return const_cast<ControlBlockInPlace*>(std::launder(reinterpret_cast<const ControlBlockInPlace*>(buffer)));
+    }
+    // Whether `block` holds an `Object` in place and `object` is that one, not a base or a member of another type
+    // at the same address
+    static bool Holds(const ControlBlockBase* block, const Object* object) {
+        return reinterpret_cast<uintptr_t>(object) - ObjectOffset() == reinterpret_cast<uintptr_t>(block) &&
+               block->InPlaceTag() == &kTag;
+    }
+
+    virtual const void* InPlaceTag() const override {
+        return &kTag;
+    }
+
+protected:
+    ~ControlBlockInPlace() = default;
+
 private:
-    Y* ptr_;
-    size_t ref_counter_;
-    size_t weak_ref_counter_;
+    // Not a standard-layout class, but both GCC and Clang lay out single inheritance the obvious way
+    static constexpr size_t ObjectOffset() {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+        return offsetof(ControlBlockInPlace, buffer_);
+#pragma GCC diagnostic pop
+    }
+
+    static constexpr char kTag = 0;  // Only its address matters
+
+    std::aligned_storage_t<sizeof(Object), alignof(Object)> buffer_;
 };
 
-template <typename Y>
-class ControlBlockOwning : public ControlBlockBase {
+// Both the block and the object are allocated with `Alloc` rebound to the block type.
+template <typename Y, typename Alloc = DefaultBlockAllocator<std::remove_cv_t<Y>>>
+class ControlBlockOwning final : public ControlBlockInPlace<std::remove_cv_t<Y>> {
+    using Object = std::remove_cv_t<Y>;
+    using ObjectAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Object>;
+    using ObjectTraits = std::allocator_traits<ObjectAllocator>;
+    using BlockAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockOwning>;
+    using BlockTraits = std::allocator_traits<BlockAllocator>;
+
     template <typename... Args>
-    ControlBlockOwning(Args&&... args) : ref_counter_(0), weak_ref_counter_(0) {
-        new (&buffer_) Y(std::forward<Args>(args)...);
+    ControlBlockOwning(const Alloc& alloc, Args&&... args) : allocator_(alloc) {
+        ObjectAllocator object_allocator(allocator_);
+        ObjectTraits::construct(object_allocator, this->GetObject(), std::forward<Args>(args)...);
+        this->template TrackCreate<Y>(sizeof(ControlBlockOwning));
     }
 
-    virtual void IncrementRefCounter() override {
-        ++ref_counter_;
-        ++weak_ref_counter_;
+    virtual bool DestroyObject() override {
+        if (!SharedReleasePolicyOf<Y>::Type::Release(this->GetObject(), this, &FinishRelease)) {
+            return false;
+        }
+        Destroy();
+        return true;
     }
-    virtual void DecrementRefCounter() override {
-        --ref_counter_;
-        --weak_ref_counter_;
-        if (ref_counter_ == 0) {
-            ++weak_ref_counter_;  // This prevents us from clearing memory "under legs" in ESFT case
-            reinterpret_cast<Y*>(&buffer_)->~Y();
-            --weak_ref_counter_;
+    virtual void DeallocateBlock() override {
+        BlockAllocator allocator(allocator_);
+        this->~ControlBlockOwning();
+        BlockTraits::deallocate(allocator, this, 1);
+    }
+
+    static void FinishRelease(void* block) {
+        auto self = static_cast<ControlBlockOwning*>(block);
+        self->Destroy();
+        self->DecrementWeakRefCounter();
+    }
+
+    void Destroy() {
+        this->template TrackDestroy<Y>(sizeof(ControlBlockOwning));
+        ObjectAllocator object_allocator(allocator_);
+        ObjectTraits::destroy(object_allocator, this->GetObject());
+    }
+
+    [[no_unique_address]] BlockAllocator allocator_;
+
+    template <typename T, typename A, typename... Args>
+        requires(!std::is_array_v<T>)
+    friend SharedPtr<T> AllocateShared(const A& alloc, Args&&... args);
+};
+
+// Elements follow the block in the same allocation, at an `Alignment`-aligned offset.
+template <typename E, typename Alloc, size_t Alignment>
+class ControlBlockArray final : public ControlBlockBase {
+    static_assert(!std::is_array_v<E>, "Multidimensional arrays are not supported");
+
+    struct alignas(Alignment) Unit {
+        std::byte bytes[Alignment];
+    };
+    using UnitAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Unit>;
+    using UnitTraits = std::allocator_traits<UnitAllocator>;
+    using ElementAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<E>;
+    using ElementTraits = std::allocator_traits<ElementAllocator>;
+
+    // `construct(allocator, element)` initializes one element. If it throws, already constructed ones
+    // are destroyed and the memory is freed.
+    template <typename Construct>
+    static ControlBlockArray* Create(const Alloc& alloc, size_t size, Construct&& construct) {
+        static_assert(alignof(ControlBlockArray) <= Alignment);
+        if (size > (std::numeric_limits<size_t>::max() - ElementsOffset() - Alignment) / sizeof(E)) {
+            throw std::bad_array_new_length();
         }
-        if (weak_ref_counter_ == 0) {
-            delete this;
+        UnitAllocator allocator(alloc);
+        Unit* memory = UnitTraits::allocate(allocator, UnitCount(size));
+        auto block = ::new (memory) ControlBlockArray(allocator, size);
+        ElementAllocator element_allocator(allocator);
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                construct(element_allocator, block->GetElements() + constructed);
+            }
+        } catch (...) {
+            block->DestroyElements(constructed);
+            block->DeallocateBlock();
+            throw;
         }
+        block->template TrackCreate<E>(UnitCount(size) * sizeof(Unit));
+        return block;
     }
 
-    virtual void IncrementWeakRefCounter() override {
-        ++weak_ref_counter_;
+    ControlBlockArray(const UnitAllocator& allocator, size_t size) : size_(size), allocator_(allocator) {
     }
-    virtual void DecrementWeakRefCounter() override {
-        --weak_ref_counter_;
-        if (weak_ref_counter_ == 0) {
-            delete this;
+
+    virtual bool DestroyObject() override {
+        if (!SharedReleasePolicyOf<E>::Type::Release(GetElements(), this, &FinishRelease)) {
+            return false;
         }
+        Destroy();
+        return true;
+    }
+    virtual void DeallocateBlock() override {
+        UnitAllocator allocator(allocator_);
+        size_t units = UnitCount(size_);
+        this->~ControlBlockArray();
+        UnitTraits::deallocate(allocator, reinterpret_cast<Unit*>(this), units);
     }
 
-    virtual size_t GetRefCount() override {
-        return ref_counter_;
+    static void FinishRelease(void* block) {
+        auto self = static_cast<ControlBlockArray*>(block);
+        self->Destroy();
+        self->DecrementWeakRefCounter();
     }
 
-private:
-    std::aligned_storage_t<sizeof(Y), alignof(Y)> buffer_;
-    size_t ref_counter_;
-    size_t weak_ref_counter_;
+    static size_t ElementsOffset() {
+        return (sizeof(ControlBlockArray) + Alignment - 1) / Alignment * Alignment;
+    }
+    static size_t UnitCount(size_t size) {
+        return (ElementsOffset() + size * sizeof(E) + Alignment - 1) / Alignment;
+    }
 
-    template <typename T, typename... Args>
-    friend SharedPtr<T> MakeShared(Args&&... args);
+    E* GetElements() {
+        return reinterpret_cast<E*>(reinterpret_cast<std::byte*>(this) + ElementsOffset());
+    }
+    void Destroy() {
+        TrackDestroy<E>(UnitCount(size_) * sizeof(Unit));
+        DestroyElements(size_);
+    }
+    // In reverse order, like built-in arrays
+    void DestroyElements(size_t count) {
+        ElementAllocator element_allocator(allocator_);
+        for (size_t i = count; i > 0; --i) {
+            ElementTraits::destroy(element_allocator, GetElements() + i - 1);
+        }
+    }
+
+    size_t size_;
+    [[no_unique_address]] UnitAllocator allocator_;
+
+    template <typename T, size_t A, typename Al, typename Construct>
+    friend SharedPtr<T> AllocateSharedArray(const Al& alloc, size_t size, Construct&& construct);
 };
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
+// `SharedPtr<T[]>` and `SharedPtr<T[N]>` manage arrays: `operator[]` instead of `*` and `->`.
 template <typename T>
 class SharedPtr {
 public:
+    using ElementType = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -121,7 +467,10 @@ public:
     SharedPtr(std::nullptr_t) noexcept : SharedPtr() {
     }
     template <typename Y>
+        requires(!std::is_array_v<T>)
     explicit SharedPtr(Y* ptr) noexcept : block_(new ControlBlockWithPtr(ptr)), observer_(ptr) {
+        static_assert(!std::is_convertible_v<Y*, ESFTInPlaceBase*>,
+                      "Objects with EnableSharedFromThisInPlace can only be made by MakeShared/AllocateShared");
         if (block_) {
             block_->IncrementRefCounter();
             if constexpr (std::is_convertible_v<Y*, ESFTBase*>) {
@@ -130,6 +479,39 @@ public:
         }
     }
 
+    // Array is deleted with `delete[]`
+    template <typename Y>
+        requires std::is_array_v<T>
+    explicit SharedPtr(Y* ptr) : SharedPtr(ptr, MyDefaultDelete<Y[]>()) {
+    }
+
+    // `deleter(ptr)` is called instead of `delete ptr`, the block is allocated with `alloc`
+    template <typename Y, typename Deleter>
+    SharedPtr(Y* ptr, Deleter deleter)
+        : SharedPtr(ptr, std::move(deleter), DefaultBlockAllocator<std::remove_cv_t<Y>>()) {
+    }
+    // Owns null, `deleter(nullptr)` is called when the last owner goes away
+    template <typename Deleter>
+    SharedPtr(std::nullptr_t, Deleter deleter) : SharedPtr(static_cast<ElementType*>(nullptr), std::move(deleter)) {
+    }
+    template <typename Deleter, typename Alloc>
+    SharedPtr(std::nullptr_t, Deleter deleter, const Alloc& alloc)
+        : SharedPtr(static_cast<ElementType*>(nullptr), std::move(deleter), alloc) {
+    }
+    template <typename Y, typename Deleter, typename Alloc>
+    SharedPtr(Y* ptr, Deleter deleter, const Alloc& alloc)
+        : block_(ControlBlockWithDeleter<Y, Deleter, Alloc>::Create(ptr, std::move(deleter), alloc)),
+          observer_(ptr) {
+        static_assert(!std::is_convertible_v<Y*, ESFTInPlaceBase*>,
+                      "Objects with EnableSharedFromThisInPlace can only be made by MakeShared/AllocateShared");
+        block_->IncrementRefCounter();
+        if constexpr (!std::is_array_v<T> && std::is_convertible_v<Y*, ESFTBase*>) {
+            if (ptr) {
+                ptr->weak_this_ = WeakPtr(*this);
+            }
+        }
+    }
+
     template <typename U>
     SharedPtr(const SharedPtr<U>& other) noexcept
         : block_(other.block_), observer_(other.observer_) {
@@ -156,7 +538,7 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) noexcept : block_(other.block_), observer_(ptr) {
+    SharedPtr(const SharedPtr<Y>& other, ElementType* ptr) noexcept : block_(other.block_), observer_(ptr) {
         if (block_) {
             block_->IncrementRefCounter();
         }
@@ -164,41 +546,35 @@ public:
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other) {
-        if (other.Expired()) {
+    explicit SharedPtr(const WeakPtr<T>& other) : block_(other.block_), observer_(other.observer_) {
+        if (!block_ || !block_->TryIncrementRefCounter()) {
             throw BadWeakPtr();
         }
-        block_ = other.block_;
-        observer_ = other.observer_;
-        if (block_) {
-            block_->IncrementRefCounter();
-        }
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
-    // Fashioned operator=
+    // Each one does the minimum of counter operations: an increment for a new owner, a decrement for the old one,
+    // none if the block stays the same. The old reference is dropped last, as it may destroy `other`.
     template <typename U>
-    SharedPtr& operator=(SharedPtr<U> other) noexcept {
-        if (block_) {
-            block_->DecrementRefCounter();
-        }
-        block_ = other.block_;
-        observer_ = other.observer_;
-        if (block_) {
-            block_->IncrementRefCounter();
-        }
+    SharedPtr& operator=(const SharedPtr<U>& other) noexcept {
+        Assign(other.block_, other.observer_);
         return *this;
     }
-    SharedPtr& operator=(SharedPtr other) noexcept {
-        if (block_) {
-            block_->DecrementRefCounter();
-        }
-        block_ = other.block_;
-        observer_ = other.observer_;
-        if (block_) {
-            block_->IncrementRefCounter();
+    SharedPtr& operator=(const SharedPtr& other) noexcept {
+        Assign(other.block_, other.observer_);
+        return *this;
+    }
+
+    template <typename U>
+    SharedPtr& operator=(SharedPtr<U>&& other) noexcept {
+        Steal(other);
+        return *this;
+    }
+    SharedPtr& operator=(SharedPtr&& other) noexcept {
+        if (this != &other) {
+            Steal(other);
         }
         return *this;
     }
@@ -216,11 +592,14 @@ public:
     // Modifiers
 
     void Reset() {
-        *this = SharedPtr<T>(nullptr);
+        observer_ = nullptr;
+        if (auto block = std::exchange(block_, nullptr)) {
+            block->DecrementRefCounter();
+        }
     }
     template <typename Y>
     void Reset(Y* ptr) {
-        *this = SharedPtr<T>(ptr);
+        SharedPtr(ptr).Swap(*this);
     }
     void Swap(SharedPtr& other) {
         std::swap(block_, other.block_);
@@ -230,15 +609,24 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
 
-    T* Get() const {
+    ElementType* Get() const {
         return observer_;
     }
-    T& operator*() const {
+    T& operator*() const
+        requires(!std::is_array_v<T>)
+    {
         return *observer_;
     }
-    T* operator->() const {
+    T* operator->() const
+        requires(!std::is_array_v<T>)
+    {
         return observer_;
     }
+    ElementType& operator[](ptrdiff_t index) const
+        requires std::is_array_v<T>
+    {
+        return observer_[index];
+    }
     size_t UseCount() const {
         return block_ ? block_->GetRefCount() : 0;
     }
@@ -246,9 +634,43 @@ public:
         return observer_ != nullptr;
     }
 
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Immortal objects
+
+    // The object is never destroyed; with `SMART_PTRS_IMMORTAL_OBJECTS` copies of the pointer don't change
+    // the counter either, see ref_counters.h. E.g. for singletons and interned constants that are copied around
+    // from all threads. Call it before the pointer is shared with other threads.
+    void MakeImmortal() const {
+        if (block_) {
+            block_->MakeImmortal();
+        }
+    }
+
 private:
+    template <typename U>
+    void Assign(ControlBlockBase* block, U* observer) {
+        observer_ = observer;
+        if (block_ == block) {
+            return;
+        }
+        if (block) {
+            block->IncrementRefCounter();
+        }
+        if (auto old = std::exchange(block_, block)) {
+            old->DecrementRefCounter();
+        }
+    }
+    template <typename U>
+    void Steal(SharedPtr<U>& other) {
+        auto old = std::exchange(block_, std::exchange(other.block_, nullptr));
+        observer_ = std::exchange(other.observer_, nullptr);
+        if (old) {
+            old->DecrementRefCounter();
+        }
+    }
+
     ControlBlockBase* block_;
-    T* observer_;
+    ElementType* observer_;
 
     template <typename Y>
     friend class SharedPtr;
@@ -256,8 +678,21 @@ private:
     template <typename Y>
     friend class WeakPtr;
 
-    template <typename U, typename... Args>
-    friend SharedPtr<U> MakeShared(Args&&... args);
+    template <typename Y>
+    friend class AtomicSharedPtr;
+
+    template <typename Y>
+    friend class EnableSharedFromThisInPlace;
+
+    template <typename Y>
+    friend class ThinSharedPtr;
+
+    template <typename U, typename A, typename... Args>
+        requires(!std::is_array_v<U>)
+    friend SharedPtr<U> AllocateShared(const A& alloc, Args&&... args);
+
+    template <typename U, size_t A, typename Al, typename Construct>
+    friend SharedPtr<U> AllocateSharedArray(const Al& alloc, size_t size, Construct&& construct);
 };
 
 template <typename T, typename U>
@@ -265,13 +700,28 @@ inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
     return left.Get() == right.Get();
 }
 
-// Allocate memory only once
-template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
+// Allocate memory only once, with `alloc` rebound to the control block.
+// Object is constructed and destroyed through `alloc` too, so `std::pmr` allocators propagate into it.
+template <typename T, typename Alloc, typename... Args>
+    requires(!std::is_array_v<T>)
+SharedPtr<T> AllocateShared(const Alloc& alloc, Args&&... args) {
+    if constexpr (std::is_convertible_v<T*, ESFTInPlaceBase*>) {
+        static_assert(std::is_same_v<std::remove_cv_t<T>, typename T::SharedFromThisType>,
+                      "EnableSharedFromThisInPlace<T> finds the block of T only, derived classes need "
+                      "EnableSharedFromThis");
+    }
+    using Block = ControlBlockOwning<T, Alloc>;
+    typename Block::BlockAllocator block_allocator(alloc);
+    Block* control_block = Block::BlockTraits::allocate(block_allocator, 1);
+    try {
+        ::new (control_block) Block(alloc, std::forward<Args>(args)...);
+    } catch (...) {
+        Block::BlockTraits::deallocate(block_allocator, control_block, 1);
+        throw;
+    }
     SharedPtr<T> result;
-    auto control_block = new ControlBlockOwning<T>(std::forward<Args>(args)...);
     result.block_ = control_block;
-    result.observer_ = reinterpret_cast<T*>(&control_block->buffer_);
+    result.observer_ = control_block->GetObject();
     result.block_->IncrementRefCounter();
     if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
         result.observer_->weak_this_ = WeakPtr(result);
@@ -279,6 +729,93 @@ SharedPtr<T> MakeShared(Args&&... args) {
     return result;
 }
 
+// For request-scoped arenas, like `std::pmr::monotonic_buffer_resource`
+template <typename T, typename Resource, typename... Args>
+    requires(!std::is_array_v<T> && std::is_convertible_v<Resource*, std::pmr::memory_resource*>)
+SharedPtr<T> AllocateShared(Resource* resource, Args&&... args) {
+    return AllocateShared<T>(std::pmr::polymorphic_allocator<std::byte>(resource), std::forward<Args>(args)...);
+}
+
+template <typename T, typename... Args>
+    requires(!std::is_array_v<T>)
+SharedPtr<T> MakeShared(Args&&... args) {
+    return AllocateShared<T>(DefaultBlockAllocator<std::remove_cv_t<T>>(), std::forward<Args>(args)...);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arrays: the block and the elements are allocated at once.
+// `Alignment` applies to the first element, e.g. 64 for AVX-512 loads.
+
+template <typename T, size_t Alignment, typename Alloc, typename Construct>
+SharedPtr<T> AllocateSharedArray(const Alloc& alloc, size_t size, Construct&& construct) {
+    using Element = std::remove_cv_t<std::remove_extent_t<T>>;
+    static_assert(!std::is_convertible_v<Element*, ESFTInPlaceBase*>,
+                  "Array elements can't have EnableSharedFromThisInPlace");
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+    using Block = ControlBlockArray<Element, Alloc,
+                                    std::max({Alignment, alignof(Element), alignof(std::max_align_t)})>;
+    Block* control_block = Block::Create(alloc, size, std::forward<Construct>(construct));
+    SharedPtr<T> result;
+    result.block_ = control_block;
+    result.observer_ = control_block->GetElements();
+    result.block_->IncrementRefCounter();
+    return result;
+}
+
+// Value-initialized: `MakeShared<double[]>(n)` is zeroed
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>), typename Alloc>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T> AllocateShared(const Alloc& alloc, size_t size) {
+    return AllocateSharedArray<T, Alignment>(alloc, size, [](auto& allocator, auto* element) {
+        std::allocator_traits<std::remove_reference_t<decltype(allocator)>>::construct(allocator, element);
+    });
+}
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>), typename Alloc>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T> AllocateShared(const Alloc& alloc, size_t size, const std::remove_extent_t<T>& value) {
+    return AllocateSharedArray<T, Alignment>(alloc, size, [&](auto& allocator, auto* element) {
+        std::allocator_traits<std::remove_reference_t<decltype(allocator)>>::construct(allocator, element, value);
+    });
+}
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>), typename Alloc, typename... Args>
+    requires std::is_bounded_array_v<T> && (sizeof...(Args) <= 1)
+SharedPtr<T> AllocateShared(const Alloc& alloc, const Args&... value) {
+    return AllocateShared<std::remove_extent_t<T>[], Alignment>(alloc, std::extent_v<T>, value...);
+}
+
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>)>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T> MakeShared(size_t size) {
+    return AllocateShared<T, Alignment>(DefaultBlockAllocator<std::byte>(), size);
+}
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>)>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T> MakeShared(size_t size, const std::remove_extent_t<T>& value) {
+    return AllocateShared<T, Alignment>(DefaultBlockAllocator<std::byte>(), size, value);
+}
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>), typename... Args>
+    requires std::is_bounded_array_v<T> && (sizeof...(Args) <= 1)
+SharedPtr<T> MakeShared(const Args&... value) {
+    return AllocateShared<T, Alignment>(DefaultBlockAllocator<std::byte>(), value...);
+}
+
+// Default-initialized: trivial elements are left as is, nothing is spent on zeroing a buffer
+// that is going to be overwritten anyway
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>)>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T> MakeSharedForOverwrite(size_t size) {
+    return AllocateSharedArray<T, Alignment>(DefaultBlockAllocator<std::byte>(), size,
+                                             []([[maybe_unused]] auto& allocator, auto* element) {
+                                                 ::new (static_cast<void*>(element))
+                                                     std::remove_pointer_t<decltype(element)>;
+                                             });
+}
+template <typename T, size_t Alignment = alignof(std::remove_extent_t<T>)>
+    requires std::is_bounded_array_v<T>
+SharedPtr<T> MakeSharedForOverwrite() {
+    return MakeSharedForOverwrite<std::remove_extent_t<T>[], Alignment>(std::extent_v<T>);
+}
+
 // Look for usage examples in tests
 template <typename T>
 class EnableSharedFromThis : public ESFTBase {
@@ -303,6 +840,61 @@ private:
     template <typename>
     friend class SharedPtr;
 
-    template <typename Y, typename... Args>
-    friend SharedPtr<Y> MakeShared(Args&&... args);
+    template <typename Y, typename A, typename... Args>
+        requires(!std::is_array_v<Y>)
+    friend SharedPtr<Y> AllocateShared(const A& alloc, Args&&... args);
+};
+
+// Zero-overhead `EnableSharedFromThis`: stores nothing, the control block is found at a fixed offset from the object.
+// Only for objects made by `MakeShared`/`AllocateShared` as `T` itself, `SharedPtr(ptr)` won't compile.
+// Objects adopted from raw pointers and class hierarchies need `EnableSharedFromThis`.
+template <typename T>
+class EnableSharedFromThisInPlace : public ESFTInPlaceBase {
+public:
+    using SharedFromThisType = T;
+
+    // Throws `BadWeakPtr` in constructor and destructor of the object, like `EnableSharedFromThis`
+    SharedPtr<T> SharedFromThis() {
+        return Promote(static_cast<T*>(this));
+    }
+    SharedPtr<const T> SharedFromThis() const {
+        return Promote(static_cast<const T*>(this));
+    }
+
+    // Empty in constructor and destructor of the object
+    WeakPtr<T> WeakFromThis() noexcept {
+        return Demote(static_cast<T*>(this));
+    }
+    WeakPtr<const T> WeakFromThis() const noexcept {
+        return Demote(static_cast<const T*>(this));
+    }
+
+private:
+    static ControlBlockBase* BlockOf(const T* object) {
+        return ControlBlockInPlace<T>::FromObject(object);
+    }
+
+    // No strong references before `MakeShared` takes the first one
+    template <typename U>
+    static SharedPtr<U> Promote(U* object) {
+        auto block = BlockOf(object);
+        if (block->GetRefCount() == 0 || !block->TryIncrementRefCounter()) {
+            throw BadWeakPtr();
+        }
+        SharedPtr<U> result;
+        result.block_ = block;
+        result.observer_ = object;
+        return result;
+    }
+    template <typename U>
+    static WeakPtr<U> Demote(U* object) {
+        WeakPtr<U> result;
+        auto block = BlockOf(object);
+        if (block->GetRefCount() != 0) {
+            block->IncrementWeakRefCounter();
+            result.block_ = block;
+            result.observer_ = object;
+        }
+        return result;
+    }
 };
@@ -10,3 +10,9 @@ class SharedPtr;
 
 template <typename T>
 class WeakPtr;
+
+template <typename T>
+class AtomicSharedPtr;
+
+template <typename T>
+class ThinSharedPtr;
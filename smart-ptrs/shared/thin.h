@@ -0,0 +1,165 @@
+#pragma once
+
+#include "shared.h"
+#include "sw_fwd.h"  // Forward declaration
+
+#include <cstddef>  // std::nullptr_t
+#include <stdexcept>
+#include <type_traits>
+#include <utility>  // std::exchange
+
+// `SharedPtr` in a single word, for pointer-dense containers and graph edges.
+// Only for objects made by `MakeShared`/`AllocateShared` as `T` itself: such an object sits at a fixed offset
+// inside its control block, so the pointer to the block is enough. No aliasing, no adopted raw pointers,
+// no conversions between types: convert to `SharedPtr` for those.
+template <typename T>
+class ThinSharedPtr {
+    static_assert(!std::is_array_v<T>, "Arrays are not stored in place");
+
+    using Object = std::remove_cv_t<T>;
+    using Block = ControlBlockInPlace<Object>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ThinSharedPtr() noexcept : block_(nullptr) {
+    }
+    ThinSharedPtr(std::nullptr_t) noexcept : ThinSharedPtr() {
+    }
+
+    ThinSharedPtr(const ThinSharedPtr& other) noexcept : block_(other.block_) {
+        if (block_) {
+            block_->IncrementRefCounter();
+        }
+    }
+    ThinSharedPtr(ThinSharedPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    // Throws `std::invalid_argument` unless `other` owns an object made in place as `T`: aliasing pointers
+    // and pointers converted from `MakeShared<Derived>` are rejected
+    explicit ThinSharedPtr(const SharedPtr<T>& other) : block_(BlockOf(other)) {
+        if (block_) {
+            block_->IncrementRefCounter();
+        }
+    }
+    explicit ThinSharedPtr(SharedPtr<T>&& other) : block_(BlockOf(other)) {
+        other.block_ = nullptr;
+        other.observer_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    // Minimal counter operations, as in `SharedPtr`
+    ThinSharedPtr& operator=(const ThinSharedPtr& other) noexcept {
+        if (block_ == other.block_) {
+            return *this;
+        }
+        if (other.block_) {
+            other.block_->IncrementRefCounter();
+        }
+        if (auto old = std::exchange(block_, other.block_)) {
+            old->DecrementRefCounter();
+        }
+        return *this;
+    }
+    ThinSharedPtr& operator=(ThinSharedPtr&& other) noexcept {
+        if (this != &other) {
+            if (auto old = std::exchange(block_, std::exchange(other.block_, nullptr))) {
+                old->DecrementRefCounter();
+            }
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ThinSharedPtr() {
+        if (block_) {
+            block_->DecrementRefCounter();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Conversions
+
+    // Back to the full pointer, e.g. to make a `WeakPtr`
+    operator SharedPtr<T>() const& {
+        SharedPtr<T> result;
+        if (block_) {
+            block_->IncrementRefCounter();
+            result.block_ = block_;
+            result.observer_ = Get();
+        }
+        return result;
+    }
+    operator SharedPtr<T>() && {
+        SharedPtr<T> result;
+        result.observer_ = Get();
+        result.block_ = std::exchange(block_, nullptr);
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (auto block = std::exchange(block_, nullptr)) {
+            block->DecrementRefCounter();
+        }
+    }
+    void Swap(ThinSharedPtr& other) {
+        std::swap(block_, other.block_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return block_ ? block_->GetObject() : nullptr;
+    }
+    T& operator*() const {
+        return *block_->GetObject();
+    }
+    T* operator->() const {
+        return block_->GetObject();
+    }
+    size_t UseCount() const {
+        return block_ ? block_->GetRefCount() : 0;
+    }
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+private:
+    static Block* BlockOf(const SharedPtr<T>& other) {
+        if (!other.block_) {
+            return nullptr;
+        }
+        if (!Block::Holds(other.block_, other.observer_)) {
+            throw std::invalid_argument("ThinSharedPtr needs an object made by MakeShared/AllocateShared");
+        }
+        return static_cast<Block*>(other.block_);
+    }
+
+    Block* block_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ThinSharedPtr<T>& left, const ThinSharedPtr<U>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename Alloc, typename... Args>
+    requires(!std::is_array_v<T>)
+ThinSharedPtr<T> AllocateThinShared(const Alloc& alloc, Args&&... args) {
+    return ThinSharedPtr<T>(AllocateShared<T>(alloc, std::forward<Args>(args)...));
+}
+
+template <typename T, typename... Args>
+    requires(!std::is_array_v<T>)
+ThinSharedPtr<T> MakeThinShared(Args&&... args) {
+    return ThinSharedPtr<T>(MakeShared<T>(std::forward<Args>(args)...));
+}
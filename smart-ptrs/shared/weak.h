@@ -1,6 +1,7 @@
 #pragma once
 
 #include <type_traits>
+#include <utility>  // std::exchange
 #include "shared.h"
 #include "sw_fwd.h"  // Forward declaration
 
@@ -47,26 +48,30 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
+    // Minimal counter operations, as in `SharedPtr`
     template <typename U>
-    WeakPtr& operator=(WeakPtr<U> other) noexcept {
-        if (block_) {
-            block_->DecrementWeakRefCounter();
-        }
-        block_ = other.block_;
-        observer_ = other.observer_;
-        if (block_) {
-            block_->IncrementWeakRefCounter();
-        }
+    WeakPtr& operator=(const WeakPtr<U>& other) noexcept {
+        Assign(other.block_, other.observer_);
         return *this;
     }
-    WeakPtr& operator=(WeakPtr other) noexcept {
-        if (block_) {
-            block_->DecrementWeakRefCounter();
-        }
-        block_ = other.block_;
-        observer_ = other.observer_;
-        if (block_) {
-            block_->IncrementWeakRefCounter();
+    WeakPtr& operator=(const WeakPtr& other) noexcept {
+        Assign(other.block_, other.observer_);
+        return *this;
+    }
+    template <typename U>
+    WeakPtr& operator=(const SharedPtr<U>& other) noexcept {
+        Assign(other.block_, other.observer_);
+        return *this;
+    }
+
+    template <typename U>
+    WeakPtr& operator=(WeakPtr<U>&& other) noexcept {
+        Steal(other);
+        return *this;
+    }
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
+        if (this != &other) {
+            Steal(other);
         }
         return *this;
     }
@@ -84,7 +89,10 @@ public:
     // Modifiers
 
     void Reset() {
-        *this = WeakPtr<T>();
+        observer_ = nullptr;
+        if (auto block = std::exchange(block_, nullptr)) {
+            block->DecrementWeakRefCounter();
+        }
     }
     void Swap(WeakPtr& other) {
         std::swap(block_, other.block_);
@@ -100,16 +108,47 @@ public:
     bool Expired() const {
         return UseCount() == 0;
     }
+    // Single "increment if not zero", no separate `Expired()` check to race with the last release
     SharedPtr<T> Lock() const {
-        return Expired() ? SharedPtr<T>() : SharedPtr<T>(*this);
+        SharedPtr<T> result;
+        if (block_ && block_->TryIncrementRefCounter()) {
+            result.block_ = block_;
+            result.observer_ = observer_;
+        }
+        TrackStats<std::remove_cv_t<std::remove_extent_t<T>>>::OnLock(result.block_ != nullptr);
+        return result;
     }
 
 private:
+    template <typename U>
+    void Assign(ControlBlockBase* block, U* observer) {
+        observer_ = observer;
+        if (block_ == block) {
+            return;
+        }
+        if (block) {
+            block->IncrementWeakRefCounter();
+        }
+        if (auto old = std::exchange(block_, block)) {
+            old->DecrementWeakRefCounter();
+        }
+    }
+    template <typename U>
+    void Steal(WeakPtr<U>& other) {
+        auto old = std::exchange(block_, std::exchange(other.block_, nullptr));
+        observer_ = std::exchange(other.observer_, nullptr);
+        if (old) {
+            old->DecrementWeakRefCounter();
+        }
+    }
+
     ControlBlockBase* block_;
-    T* observer_;
+    std::remove_extent_t<T>* observer_;
 
     template <typename Y>
     friend class SharedPtr;
     template <typename Y>
     friend class WeakPtr;
+    template <typename Y>
+    friend class EnableSharedFromThisInPlace;
 };
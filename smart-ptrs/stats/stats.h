@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <iosfwd>
+
+// Per-type pointer statistics: how many objects of a type were created, how many are alive at most,
+// how much refcount traffic they cause. Off by default and compiled out: the hooks below are empty
+// unless `SMART_PTRS_STATS` is defined (for the whole program!).
+//
+// Objects are counted by the type they are created with: the pointee of a `SharedPtr` control block,
+// the `Derived` of `RefCounted`, the `T` of `UniquePtr`. Increments and decrements are strong ones;
+// `UniquePtr` has none, its `Release()` and conversions move an object out of the statistics of its type.
+
+#ifdef SMART_PTRS_STATS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>  // std::move
+#include <vector>
+
+class PointerStats {
+public:
+    struct Snapshot {
+        std::string type;
+        uint64_t allocations;
+        uint64_t increments;
+        uint64_t decrements;
+        uint64_t weak_locks;
+        uint64_t failed_locks;
+        int64_t live_objects;
+        int64_t peak_objects;
+        int64_t live_bytes;
+        int64_t peak_bytes;
+    };
+
+    PointerStats(const PointerStats&) = delete;
+    PointerStats& operator=(const PointerStats&) = delete;
+
+    template <typename T>
+    static PointerStats& Of() {
+        // Never destroyed: pointers may die during static destruction.
+        static auto stats = new PointerStats(TypeName<T>());
+        return *stats;
+    }
+
+    void OnCreate(size_t bytes) {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        OnAdopt(bytes);
+    }
+    void OnDestroy(size_t bytes) {
+        OnDisown(bytes);
+    }
+    // Ownership moves between types without creating or destroying an object
+    void OnDisown(size_t bytes) {
+        live_objects_.fetch_sub(1, std::memory_order_relaxed);
+        live_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    void OnAdopt(size_t bytes) {
+        UpdatePeak(peak_objects_, live_objects_.fetch_add(1, std::memory_order_relaxed) + 1);
+        UpdatePeak(peak_bytes_, live_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+    void OnIncrement() {
+        increments_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void OnDecrement() {
+        decrements_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void OnLock(bool success) {
+        weak_locks_.fetch_add(1, std::memory_order_relaxed);
+        if (!success) {
+            failed_locks_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot Get() const {
+        return {type_,
+                allocations_.load(std::memory_order_relaxed),
+                increments_.load(std::memory_order_relaxed),
+                decrements_.load(std::memory_order_relaxed),
+                weak_locks_.load(std::memory_order_relaxed),
+                failed_locks_.load(std::memory_order_relaxed),
+                live_objects_.load(std::memory_order_relaxed),
+                peak_objects_.load(std::memory_order_relaxed),
+                live_bytes_.load(std::memory_order_relaxed),
+                peak_bytes_.load(std::memory_order_relaxed)};
+    }
+
+    // All types seen so far, the ones with the most refcount traffic first.
+    static std::vector<Snapshot> GetAll() {
+        std::vector<Snapshot> result;
+        for (PointerStats* stats = Registry().load(std::memory_order_acquire); stats; stats = stats->next_) {
+            result.push_back(stats->Get());
+        }
+        std::sort(result.begin(), result.end(), [](const Snapshot& left, const Snapshot& right) {
+            return left.increments + left.decrements > right.increments + right.decrements;
+        });
+        return result;
+    }
+
+private:
+    explicit PointerStats(std::string type) : type_(std::move(type)) {
+        next_ = Registry().load(std::memory_order_relaxed);
+        while (!Registry().compare_exchange_weak(next_, this, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    // No RTTI needed: "... [with T = Foo]" (GCC) or "... [T = Foo]" (Clang)
+    template <typename T>
+    static std::string TypeName() {
+        std::string_view function = __PRETTY_FUNCTION__;
+        auto begin = function.find("T = ") + 4;
+        auto end = function.find("; ", begin);
+        if (end == std::string_view::npos) {
+            end = function.rfind(']');
+        }
+        return std::string(function.substr(begin, end - begin));
+    }
+
+    static void UpdatePeak(std::atomic<int64_t>& peak, int64_t value) {
+        int64_t current = peak.load(std::memory_order_relaxed);
+        while (current < value && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    static std::atomic<PointerStats*>& Registry() {
+        static std::atomic<PointerStats*> head = nullptr;
+        return head;
+    }
+
+    std::string type_;
+    PointerStats* next_;
+    std::atomic<uint64_t> allocations_ = 0;
+    std::atomic<uint64_t> increments_ = 0;
+    std::atomic<uint64_t> decrements_ = 0;
+    std::atomic<uint64_t> weak_locks_ = 0;
+    std::atomic<uint64_t> failed_locks_ = 0;
+    std::atomic<int64_t> live_objects_ = 0;
+    std::atomic<int64_t> peak_objects_ = 0;
+    std::atomic<int64_t> live_bytes_ = 0;
+    std::atomic<int64_t> peak_bytes_ = 0;
+};
+
+inline void DumpPointerStats(std::ostream& out) {
+    constexpr int kWidth = 12;
+    out << std::left << std::setw(40) << "type" << std::right;
+    for (const char* column : {"allocs", "incs", "decs", "locks", "failed", "live", "peak", "live B", "peak B"}) {
+        out << std::setw(kWidth) << column;
+    }
+    out << '\n';
+    for (const auto& stats : PointerStats::GetAll()) {
+        out << std::left << std::setw(40) << stats.type << std::right;
+        for (int64_t value : {int64_t(stats.allocations), int64_t(stats.increments), int64_t(stats.decrements),
+                              int64_t(stats.weak_locks), int64_t(stats.failed_locks), stats.live_objects,
+                              stats.peak_objects, stats.live_bytes, stats.peak_bytes}) {
+            out << std::setw(kWidth) << value;
+        }
+        out << '\n';
+    }
+}
+
+#else
+
+// Nothing is collected
+inline void DumpPointerStats([[maybe_unused]] std::ostream& out) {
+}
+
+#endif
+
+// Size of an object for the statistics, 0 for `void` and arrays of unknown bound. With statistics the type has
+// to be complete: a size that falls back to 0 for incomplete types would depend on where it is instantiated first.
+// Without them nothing is measured, and pointers to incomplete types (with custom deleters) still compile.
+template <typename T>
+constexpr size_t TrackedSize() {
+#ifdef SMART_PTRS_STATS
+    if constexpr (std::is_void_v<T> || std::is_unbounded_array_v<T>) {
+        return 0;
+    } else {
+        return sizeof(T);
+    }
+#else
+    return 0;
+#endif
+}
+
+// Hooks for the pointers
+template <typename T>
+struct TrackStats {
+    static void OnCreate([[maybe_unused]] size_t bytes) {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnCreate(bytes);
+#endif
+    }
+    static void OnDestroy([[maybe_unused]] size_t bytes) {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnDestroy(bytes);
+#endif
+    }
+    static void OnDisown([[maybe_unused]] size_t bytes) {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnDisown(bytes);
+#endif
+    }
+    static void OnAdopt([[maybe_unused]] size_t bytes) {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnAdopt(bytes);
+#endif
+    }
+    static void OnIncrement() {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnIncrement();
+#endif
+    }
+    static void OnDecrement() {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnDecrement();
+#endif
+    }
+    static void OnLock([[maybe_unused]] bool success) {
+#ifdef SMART_PTRS_STATS
+        PointerStats::Of<T>().OnLock(success);
+#endif
+    }
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "compressed_pair.h"
+#include "../stats/stats.h"
 
 #include <cstddef>  // std::nullptr_t
 #include <type_traits>
@@ -38,14 +39,17 @@ public:
     // Constructors
 
     explicit UniquePtr(T* ptr = nullptr) : ptr_cp_(ptr, Deleter()) {
+        TrackCreate(ptr);
     }
     template <typename FreakDeleter>
     UniquePtr(T* ptr, FreakDeleter&& deleter) : ptr_cp_(ptr, std::forward<FreakDeleter>(deleter)) {
+        TrackCreate(ptr);
     }
 
     template <typename TBase, typename DeleterBase>
     UniquePtr(UniquePtr<TBase, DeleterBase>&& other) noexcept
         : ptr_cp_(std::move(other.ptr_cp_.GetFirst()), std::move(other.ptr_cp_.GetSecond())) {
+        TrackMoveFrom(other.ptr_cp_.GetFirst());
         other.ptr_cp_.GetFirst() = nullptr;
     }
 
@@ -59,8 +63,10 @@ public:
         if (other.ptr_cp_.GetFirst() == this->ptr_cp_.GetFirst()) {
             return *this;
         }
+        TrackDestroy(ptr_cp_.GetFirst());
         ptr_cp_.GetSecond()(ptr_cp_.GetFirst());
 
+        TrackMoveFrom(other.ptr_cp_.GetFirst());
         ptr_cp_.GetFirst() = std::move(other.ptr_cp_.GetFirst());
         ptr_cp_.GetSecond() = std::move(other.ptr_cp_.GetSecond());
 
@@ -68,6 +74,7 @@ public:
         return *this;
     }
     UniquePtr& operator=(std::nullptr_t) {
+        TrackDestroy(ptr_cp_.GetFirst());
         ptr_cp_.GetSecond()(ptr_cp_.GetFirst());
         ptr_cp_.GetFirst() = nullptr;
         return *this;
@@ -79,6 +86,7 @@ public:
     // Destructor
 
     ~UniquePtr() {
+        TrackDestroy(ptr_cp_.GetFirst());
         ptr_cp_.GetSecond()(ptr_cp_.GetFirst());
     }
 
@@ -87,12 +95,17 @@ public:
 
     T* Release() {
         auto result = ptr_cp_.GetFirst();
+        if (result) {
+            TrackStats<std::remove_cv_t<T>>::OnDisown(kTrackedBytes);
+        }
         ptr_cp_.GetFirst() = nullptr;
         return result;
     }
     void Reset(T* ptr = nullptr) {
         auto what_to_delete = ptr_cp_.GetFirst();
         ptr_cp_.GetFirst() = ptr;
+        TrackCreate(ptr);
+        TrackDestroy(what_to_delete);
         ptr_cp_.GetSecond()(what_to_delete);
     }
     void Swap(UniquePtr& other) {
@@ -126,6 +139,29 @@ public:
     }
 
 private:
+    static constexpr size_t kTrackedBytes = TrackedSize<T>();
+
+    // See stats/stats.h
+    static void TrackCreate(T* ptr) {
+        if (ptr) {
+            TrackStats<std::remove_cv_t<T>>::OnCreate(kTrackedBytes);
+        }
+    }
+    static void TrackDestroy(T* ptr) {
+        if (ptr) {
+            TrackStats<std::remove_cv_t<T>>::OnDestroy(kTrackedBytes);
+        }
+    }
+    template <typename U>
+    static void TrackMoveFrom(U* ptr) {
+        if constexpr (!std::is_same_v<U, T>) {
+            if (ptr) {
+                TrackStats<std::remove_cv_t<U>>::OnDisown(TrackedSize<U>());
+                TrackStats<std::remove_cv_t<T>>::OnAdopt(kTrackedBytes);
+            }
+        }
+    }
+
     CompressedPair<T*, Deleter> ptr_cp_;  // ptr in compressed pair.
 
     template <typename TBase, typename DeleterBase>
@@ -140,14 +176,17 @@ public:
     // Constructors
 
     explicit UniquePtr(T* ptr = nullptr) : ptr_cp_(ptr, Deleter()) {
+        TrackCreate(ptr);
     }
     template <typename FreakDeleter>
     UniquePtr(T* ptr, FreakDeleter&& deleter) : ptr_cp_(ptr, std::forward<FreakDeleter>(deleter)) {
+        TrackCreate(ptr);
     }
 
     template <typename TBase, typename DeleterBase>
     UniquePtr(UniquePtr<TBase, DeleterBase>&& other) noexcept
         : ptr_cp_(std::move(other.ptr_cp_.GetFirst()), std::move(other.ptr_cp_.GetSecond())) {
+        TrackMoveFrom(other.ptr_cp_.GetFirst());
         other.ptr_cp_.GetFirst() = nullptr;
     }
 
@@ -161,8 +200,10 @@ public:
         if (&other == this) {
             return *this;
         }
+        TrackDestroy(ptr_cp_.GetFirst());
         ptr_cp_.GetSecond()(ptr_cp_.GetFirst());
 
+        TrackMoveFrom(other.ptr_cp_.GetFirst());
         ptr_cp_.GetFirst() = std::move(other.ptr_cp_.GetFirst());
         ptr_cp_.GetSecond() = std::move(other.ptr_cp_.GetSecond());
 
@@ -170,6 +211,7 @@ public:
         return *this;
     }
     UniquePtr& operator=(std::nullptr_t) {
+        TrackDestroy(ptr_cp_.GetFirst());
         ptr_cp_.GetSecond()(ptr_cp_.GetFirst());
         ptr_cp_.GetFirst() = nullptr;
         return *this;
@@ -181,6 +223,7 @@ public:
     // Destructor
 
     ~UniquePtr() {
+        TrackDestroy(ptr_cp_.GetFirst());
         ptr_cp_.GetSecond()(ptr_cp_.GetFirst());
     }
 
@@ -189,12 +232,17 @@ public:
 
     T* Release() {
         auto result = ptr_cp_.GetFirst();
+        if (result) {
+            TrackStats<std::remove_cv_t<T>>::OnDisown(kTrackedBytes);
+        }
         ptr_cp_.GetFirst() = nullptr;
         return result;
     }
     void Reset(T* ptr = nullptr) {
         auto what_to_delete = ptr_cp_.GetFirst();
         ptr_cp_.GetFirst() = ptr;
+        TrackCreate(ptr);
+        TrackDestroy(what_to_delete);
         ptr_cp_.GetSecond()(what_to_delete);
     }
     void Swap(UniquePtr& other) {
@@ -231,6 +279,29 @@ public:
     }
 
 private:
+    static constexpr size_t kTrackedBytes = 0;  // Length is unknown
+
+    // See stats/stats.h
+    static void TrackCreate(T* ptr) {
+        if (ptr) {
+            TrackStats<std::remove_cv_t<T>>::OnCreate(kTrackedBytes);
+        }
+    }
+    static void TrackDestroy(T* ptr) {
+        if (ptr) {
+            TrackStats<std::remove_cv_t<T>>::OnDestroy(kTrackedBytes);
+        }
+    }
+    template <typename U>
+    static void TrackMoveFrom(U* ptr) {
+        if constexpr (!std::is_same_v<U, T>) {
+            if (ptr) {
+                TrackStats<std::remove_cv_t<U>>::OnDisown(kTrackedBytes);
+                TrackStats<std::remove_cv_t<T>>::OnAdopt(kTrackedBytes);
+            }
+        }
+    }
+
     CompressedPair<T*, Deleter> ptr_cp_;  // ptr in compressed pair.
 
     template <typename TBase, typename DeleterBase>